@@ -42,28 +42,83 @@
 
 #define MAXPROC 50
 #define MAXMESSAGES 50
+#define MSGHASHSIZE 8 /* per-sender buckets of an inbox, must be a power of 2 */
+/* a pid is a process handle: (generation << PIDINDEXBITS) | (table index + 1) */
+#define PIDINDEXBITS 9
+#define PIDINDEXMASK ((1 << PIDINDEXBITS) - 1)
+#define MAXPCBINDEX  PIDINDEXMASK /* static table plus slab pcbs */
+
+/* ready queue priorities, the highest ready one is dispatched first (NPRIO must not exceed 8) */
+#define NPRIO       8
+#define PRIONORMAL  0 /* default, also for a create request that leaves priority to 0 */
+#define PRIODRIVER  6 /* device driver processes of the support level */
+#define PRIOSERVER  7 /* ssi, swap mutex and sst server processes */
+
+/* multi-level feedback queue over the priorities [0, MLFQLEVELS): a process that uses up its
+   time slice moves down a level, one that blocks within a slice of cpu burst moves up, and
+   every MLFQBOOST pseudo-clock periods (checked on every dispatch) the ready ones go back to the top.
+   0 disables it. */
+#define MLFQ        1
+#define MLFQLEVELS  4
+#define MLFQTOP     (MLFQLEVELS - 1)
+#define MLFQBOOST   10
 
 #define ANYMESSAGE 0
+/* pseudo sender of the DOIOASYNC completions: its index bits are 0, so it is never a pid */
+#define IOCOMPLETION (~(unsigned int)PIDINDEXMASK)
 #define MSGNOGOOD -1
 #define DEST_NOT_EXIST -2
 #define SENDMESSAGE -1
 #define RECEIVEMESSAGE -2
+/* register passed messages of MSGWORDS words:
+   send    -> a1 dest, words in a2, a3, v0, v1
+   receive -> a1 sender, v0 returns the sender, words in a2, a3, a1, v1 */
+#define SENDREGMESSAGE -3
+#define RECEIVEREGMESSAGE -4
+/* send and wait for the reply of the destination (registers as SENDREGMESSAGE/RECEIVEREGMESSAGE) */
+#define CALLMESSAGE -5
+/* a1 client, reply words in a2, a3, v0, v1, then receive from any sender as RECEIVEREGMESSAGE */
+#define REPLYRECVMESSAGE -6
+#define MSGWORDS 4
+/* services answered by the nucleus itself in v0, without going through the ssi */
+#define FASTGETTIME       -7 /* as GETTIME */
+#define FASTGETPROCESSID  -8 /* as GETPROCESSID, a1 is its argument */
+#define FASTGETSUPPORTPTR -9 /* as GETSUPPORTPTR */
+/* events of the notification word of a pcb, received as messages from the ssi */
+#define NOTIFYDEVICE 0x1 /* payload is the device status */
+#define NOTIFYCLOCK  0x2 /* payload is 0 */
 
 #define SENDMSG 1
 #define RECEIVEMSG 2
 
 #define CREATEPROCESS 1
 #define TERMPROCESS   2
-#define DOIO          3
+#define DOIO          3 /* inline as {DOIO, command address, command, DMA address of a disk/flash or 0} */
 #define GETTIME       4
 #define CLOCKWAIT     5
 #define GETSUPPORTPTR 6
 #define GETPROCESSID  7
+#define SLEEPFOR      8 /* arg is the number of microseconds to sleep, scaled to TOD ticks by TIMESCALE */
+#define SLEEPUNTIL    9 /* arg is the TOD to sleep until, in ticks as read by STCK */
+#define DOIOASYNC     10 /* as DOIO, but answered at once with a request id; the status comes later
+                            in a message with words {status, request id} from IOCOMPLETION, not from
+                            the ssi, so that it is never taken as the reply to another request */
+#define DOIOSTRING    11 /* writes a whole string to a printer or terminal transmitter, the nucleus
+                            sends every next character from the interrupt handler */
+#define READLINE      12 /* reads a line from a terminal receiver, buffered by the nucleus; answered with
+                            the number of characters, or the negated status on a receive error */
 
 #define GET_TOD 1
 #define TERMINATE 2
 #define WRITEPRINTER 3
 #define WRITETERMINAL 4
+#define FLUSHPRINTER  5 /* waits until every character written to the printer is printed */
+#define READTERMINAL  6 /* reads a line from the terminal, answered with its length */
+
+/* requests of the sst to the printer spooler */
+#define SPOOLWRITE 1 /* new characters are in the ring, answered at once */
+#define SPOOLROOM  2 /* answered when the ring is not full */
+#define SPOOLFLUSH 3 /* answered when the ring is empty and the printer idle */
 
 /* Status register constants */
 #define ALLOFF      0x00000000
@@ -122,6 +177,10 @@
 
 
 #define OKCHARTRANS  5
+/* a terminal subdevice whose status byte is neither of these has completed a command */
+#define DEVREADY     1
+#define DEVBUSY      3
+#define TERMSTATMASK 0xFF
 #define TRANSMITCHAR 2
 #define RECEIVECHAR 	2		// aggiunta comando di ricezione del carattere
 #define PRINTCHR	2		// aggiunta comando di stampa del carattere
@@ -150,15 +209,28 @@
 #define OFF        0
 #define OK         0
 #define NOPROC     -1
+#define NOREPLY    -2 /* an ssi service that answers later, when the request is done */
 #define BYTELENGTH 8
 
 #define PSECOND    100000
+/* blocked queues are indexed by [line - DEV_IL_START][devNo][subdevice] */
+#define NDEVLINES    (N_INTERRUPT_LINES - DEV_IL_START)
+#define NSUBDEV      2
+#define SUBDEVTRANSM 0 /* terminal transmitter, and the only subdevice of the other devices */
+#define SUBDEVRECV   1 /* terminal receiver */
+/* device requests, synchronous or asynchronous, that can be pending at the same time */
+#define MAXIOREQ     (MAXPROC + 2 * N_DEV_PER_IL)
+/* words of the device register area, each one has an entry in the DoIO descriptor table */
+#define NDEVWORDS    (NDEVLINES * N_DEV_PER_IL * DEV_REG_SIZE / WORDLEN)
+#define ITDISARM   0xFFFFFFFF /* raw interval timer value that acks it without a near interrupt */
 #define TIMESLICE  5000 /* length of proc's time slice	*/
 #define NEVER      0x7FFFFFFF
 #define SECOND     1000000
 #define STATESIZE  0x8C
 #define DEVICECNT  (DEVINTNUM * DEVPERINT)
 #define MAXSTRLENG 128
+#define SPOOLSIZE  512 /* characters of the ring of a printer spooler */
+#define TERMINSIZE 256 /* characters of the receive ring of a terminal */
 
 #define DELAYASID    (UPROCMAX + 1)
 #define KUSEG3SECTNO 0
@@ -197,6 +269,7 @@
 
 #define UPROCMAX 8
 #define POOLSIZE (UPROCMAX * 2)
+#define PFNMASK  0xFFFFF000 /* frame address in a pte_entryLO */
 /* End of Mikeyg constants */
 
 #define CHARRECV			5		/* Character received*/
@@ -214,7 +287,23 @@
 #define NOASID -1
 #define NOPAGE -1
 #define SWAPPOOL (RAMSTART + (MAXPAGES * PAGESIZE))
+/* free RAM frames between the swap pool and the stacks carved down from RAMTOP,
+   used to grow the pcb and message tables beyond MAXPROC/MAXMESSAGES */
+#define SLABPOOLSTART (SWAPPOOL + (POOLSIZE * PAGESIZE))
+#define SLABFRAMES 16 /* at most 32, one bit each in the frame map */
+#define SLABSLACK 8   /* free objects kept outside a frame before giving it back */
 #define TLBINVLDM 1
+/* words of the .aout header, at the start of page 0 of a U-proc: .text and .data follow each other
+   on the backing store from block 0, both rounded to whole pages */
+#define AOUTTEXTFILESZ 5
+#define AOUTDATAFILESZ 9
+#define READAHEADMAX   4 /* pages the pager may read past a faulting one */
+/* watermarks of free frames in the swap pool kept by the page cleaner */
+#define FREELOW  2
+#define FREEHIGH 4
+/* requests of the pager to the page cleaner */
+#define PAGECLEAN 1 /* make free frames, up to FREEHIGH */
+#define PAGEAHEAD 2 /* read ahead after a page fault, words {PAGEAHEAD, asid, page} */
 #define TERM0ADDR 0x10000254 /* taken from p2test */
 #define PRINT0ADDR 0x100001d4 /* dec_to_hex -> DEV_REG_ADDR(6, 0) */
 
@@ -35,6 +35,9 @@ typedef struct support_t {
     state_t    sup_exceptState[2];              /* old state exceptions			*/
     context_t  sup_exceptContext[2];            /* new contexts for passing up	*/
     pteEntry_t sup_privatePgTbl[USERPGTBLSIZE]; /* user page table				*/
+    unsigned int sup_imagePages;                /* pages of the .aout image, 0 until its header is read */
+    unsigned int sup_flashed;                   /* one bit per page written to the backing store */
+    unsigned int sup_readAhead;                 /* pages read past a fault, 1..READAHEADMAX, 0 once terminated */
     struct list_head s_list;
 } support_t;
 
@@ -43,6 +46,8 @@ typedef struct pcb_t
 {
     /* process queue  */
     struct list_head p_list;
+    /* head of the process queue p_list is linked in, NULL if none */
+    struct list_head *p_queue;
 
     /* process tree fields */
     struct pcb_t *p_parent;   /* ptr to parent	*/
@@ -52,18 +57,34 @@ typedef struct pcb_t
     /* process status information */
     state_t p_s;  /* processor state */
     cpu_t p_time; /* cpu time used by proc */
+    cpu_t p_burst; /* cpu time used since the proc last blocked */
+    int p_sleepIdx; /* position in the heap of sleeping pcbs, -1 if not sleeping */
+    unsigned int p_wakeTOD; /* TOD at which a sleeping pcb is awakened */
+    struct iorequest_t *p_ioReq; /* synchronous DoIO the pcb waits for, NULL if none */
 
     /* First message in the message queue */
     struct list_head msg_inbox;
+    /* the same messages, chained per sender and hashed by sender pid */
+    struct list_head msg_senders[MSGHASHSIZE];
+    /* 1 if the pcb is blocked in a receive, waiting for a message from p_waitFor */
+    unsigned int p_waiting;
+    /* pid of the sender the pcb is waiting for, ANYMESSAGE for any sender */
+    int p_waitFor;
+    /* pending interrupt notifications (NOTIFY* bits), delivered as messages from the ssi */
+    unsigned int p_notify;
+    /* device status carried by NOTIFYDEVICE */
+    unsigned int p_notifyStatus;
 
     /* Pointer to the support struct */
     support_t *p_supportStruct;
 
-    /* process id */
+    /* process id, that is the process handle built from p_index and the generation of the slot */
     int p_pid;
+    /* slot of the pcb in the handle table, fixed for the lifetime of the slot */
+    unsigned int p_index;
+    /* ready queue priority, in [0, NPRIO) */
+    unsigned int p_prio;
 
-    /* if pcb is blocked on some device, this number represent that device */
-    unsigned int blockedOnDevice;
     /* if pcb is blocked on some device, this number represent the type of device */
     unsigned int deviceType;
 
@@ -74,14 +95,39 @@ typedef struct msg_t
 {
     /* message queue */
     struct list_head m_list;
+    /* queue of the messages coming from the same sender (inbox only) */
+    struct list_head m_sendq;
 
-    /* thread that sent this message */
+    /* thread that sent this message, NULL for an i/o completion; stale once the sender is freed,
+       so a received message is told its sender through m_senderPid */
     struct pcb_t *m_sender;
+    /* its pid, that keeps matching after its death (inbox only) */
+    int m_senderPid;
 
-    /* the payload of the message */
-	unsigned int m_payload;
+    /* the payload of the message, up to MSGWORDS words carried inline */
+	unsigned int m_words[MSGWORDS];
 } msg_t, *msg_PTR;
 
+/* a DoIO request, queued on the FIFO of its (sub)device; the head is the one the device is serving */
+typedef struct iorequest_t
+{
+    struct list_head ir_list;  /* device FIFO, or free list */
+    struct list_head *ir_queue; /* the device FIFO */
+    int ir_pid;                /* pid of the requester, 0 if it died while the request was served */
+    memaddr *ir_cmd;           /* command register */
+    unsigned int ir_value;     /* command to write */
+    memaddr ir_data0;          /* DMA address of a disk or flash command, written in DATA0 with it; 0 if none */
+    unsigned int ir_line;      /* interrupt line of the device */
+    char *ir_buf;              /* characters of a string request, NULL otherwise */
+    unsigned int ir_len;       /* length of the string */
+    unsigned int ir_done;      /* characters of the string already written */
+    unsigned int ir_id;        /* request id of an asynchronous request, 0 for a synchronous one */
+    msg_PTR ir_msg;            /* completion message of an asynchronous request, allocated up front */
+} iorequest_t, *iorequest_PTR;
+
+/* the single word payload of SENDMESSAGE/RECEIVEMESSAGE */
+#define m_payload m_words[0]
+
 typedef struct ssi_payload_t
 {
     int service_code;
@@ -92,27 +138,87 @@ typedef struct ssi_create_process_t
 {
     state_t *state;
     support_t *support;
+    unsigned int priority; /* PRIONORMAL if left to 0 */
 } ssi_create_process_t, *ssi_create_process_PTR;
 
 typedef struct ssi_do_io_t
 {
     memaddr* commandAddr;
     unsigned int commandValue;
+    memaddr data0; /* DMA address of a disk or flash command, 0 to leave DATA0 as it is */
 } ssi_do_io_t, *ssi_do_io_PTR;
 
+typedef struct ssi_do_io_string_t
+{
+    memaddr* commandAddr; /* printer command or terminal transm_command (recv_command for READLINE) */
+    char* buffer;         /* the characters, in memory that is not mapped (e.g. a kernel stack) */
+    unsigned int length;
+} ssi_do_io_string_t, *ssi_do_io_string_PTR;
+
+/* receive ring of a terminal, filled by the interrupt handler; as in spool_t the counters never wrap the ring */
+typedef struct termin_t
+{
+    char ti_buf[TERMINSIZE];
+    unsigned int ti_head;   /* characters received */
+    unsigned int ti_tail;   /* characters read */
+    unsigned int ti_lines;  /* newlines between ti_tail and ti_head */
+    unsigned int ti_armed;  /* 1 if the receiver belongs to the ring */
+    struct pcb_t *ti_reader; /* the process waiting for a line, NULL if none */
+    char *ti_dest;          /* where the reader wants the line */
+    unsigned int ti_len;    /* and its size */
+} termin_t, *termin_PTR;
+
+/* DoIO descriptor of a word of the device register area */
+typedef struct devdesc_t
+{
+    unsigned int dd_valid;      /* 1 if the word is a command register */
+    unsigned int dd_line;       /* interrupt line of the device */
+    unsigned int dd_dev;        /* device number */
+    unsigned int dd_sub;        /* SUBDEVTRANSM or SUBDEVRECV */
+    struct list_head *dd_queue; /* FIFO of the DoIO requests (iorequest_t) of the (sub)device */
+} devdesc_t, *devdesc_PTR;
+
 typedef struct sst_print_t
 {
     int length;
     char *string;
 } sst_print_t, *sst_print_PTR;
 
+/* header at the start of every frame used by a slab cache */
+typedef struct slab_t {
+    struct list_head sl_list; /* frames of the same cache */
+    unsigned int sl_inuse;    /* objects of this frame currently allocated */
+} slab_t;
+
+/* slab cache, that is a growable pool of objects of the same size */
+typedef struct slabcache_t {
+    unsigned int sc_objsize;   /* size of a single object */
+    unsigned int sc_perslab;   /* objects carved out of a single frame */
+    struct list_head sc_slabs; /* frames owned by the cache */
+    unsigned int sc_frames;    /* number of frames owned */
+    unsigned int sc_free;      /* objects in the free list (static table included) */
+    unsigned int sc_inuse;     /* objects currently allocated */
+    unsigned int sc_highwater; /* highest sc_inuse ever reached, to size MAXPROC/MAXMESSAGES */
+} slabcache_t;
+
 /* Page swap pool information structure type */
 typedef struct swap_t {
     int         sw_asid;   /* ASID number			*/
     int         sw_pageNo; /* page's virt page no.	*/
     pteEntry_t *sw_pte;    /* page's PTE entry.	*/
+    int         sw_ref;    /* reference bit of the clock, emulated through VALIDON */
+    int         sw_ahead;  /* 1 if the page was read ahead and not used yet */
+    int         sw_busy;   /* 1 while the cleaner reads or writes the page without the mutex */
 } swap_t;
 
+/* ring buffer of a printer spooler: the sst is the only one to move sp_head,
+   the spooler the only one to move sp_tail, both counters never wrap the ring */
+typedef struct spool_t {
+    char         sp_buf[SPOOLSIZE];
+    unsigned int sp_head; /* characters written by the sst */
+    unsigned int sp_tail; /* characters printed by the spooler */
+} spool_t, *spool_PTR;
+
 typedef struct dev_payload_t {
     int asid;
     int device;
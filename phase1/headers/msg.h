@@ -4,6 +4,7 @@
 #include "../../headers/const.h"
 #include "../../headers/types.h"
 #include "../../headers/listx.h"
+#include "./slab.h"
 
 void initMsgs();
 void freeMsg(msg_t *m);
@@ -14,5 +15,8 @@ void insertMessage(struct list_head *head, msg_t *m);
 void pushMessage(struct list_head *head, msg_t *m);
 msg_t *popMessage(struct list_head *head, pcb_t *p_ptr);
 msg_t *headMessage(struct list_head *head);
+void insertInboxMessage(pcb_t *p, msg_t *m);
+msg_t *popInboxMessage(pcb_t *p, int pid);
+unsigned int msgHighWater();
 
 #endif
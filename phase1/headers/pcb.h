@@ -4,6 +4,7 @@
 #include "../../headers/const.h"
 #include "../../headers/types.h"
 #include "../../headers/listx.h"
+#include "./slab.h"
 
 void initPcbs();
 void freePcb(pcb_t *p);
@@ -18,5 +19,8 @@ int emptyChild(pcb_t *p);
 void insertChild(pcb_t *prnt, pcb_t *p);
 pcb_t *removeChild(pcb_t *p);
 pcb_t *outChild(pcb_t *p);
+pcb_t *resolvePcb(unsigned int id);
+int resolvePid(unsigned int id);
+unsigned int pcbHighWater();
 
 #endif
@@ -0,0 +1,18 @@
+#ifndef SLAB_H_INCLUDED
+#define SLAB_H_INCLUDED
+
+#include "../../headers/const.h"
+#include "../../headers/types.h"
+#include "../../headers/listx.h"
+
+void initSlabs();
+void initSlabCache(slabcache_t *c, unsigned int objsize, unsigned int statics);
+slab_t *slabGrow(slabcache_t *c);
+void *slabObject(slabcache_t *c, slab_t *s, unsigned int i);
+slab_t *slabOf(void *obj);
+unsigned int slabFrameNo(slab_t *s);
+void slabTake(slabcache_t *c, void *obj);
+slab_t *slabGive(slabcache_t *c, void *obj);
+void slabRelease(slabcache_t *c, slab_t *s);
+
+#endif
@@ -1,6 +1,35 @@
 #include "./headers/msg.h"
 static msg_t msgTable[MAXMESSAGES];
 LIST_HEAD(msgFree_h);
+/* messages beyond MAXMESSAGES are carved out of slab frames */
+static slabcache_t msgCache;
+
+/**
+ * @brief Unlinks a message both from the queue it is in and from its sender queue,
+ *        leaving the two list heads empty so that a further unlink is harmless.
+ *
+ * @param msg_t *m: the message to unlink.
+ * @return void
+ */
+static void unlinkMessage(msg_t *m)
+{
+    list_del(&m->m_list);
+    INIT_LIST_HEAD(&m->m_list);
+    list_del(&m->m_sendq);
+    INIT_LIST_HEAD(&m->m_sendq);
+}
+
+/**
+ * @brief Returns the sender queue of the inbox of p in which the messages of the sender with the given pid are chained.
+ *
+ * @param pcb_t *p: the owner of the inbox.
+ * @param int pid: the pid of the sender of the messages.
+ * @return struct list_head *: the head of the sender queue.
+ */
+static struct list_head *senderQueue(pcb_t *p, int pid)
+{
+    return &p->msg_senders[pid & (MSGHASHSIZE - 1)];
+}
 
 /**
  * @brief Initializes the list of free messages (msgFree) so that it contains all the elements of the static array of MAXMESSAGES messages.
@@ -15,40 +44,74 @@ void initMsgs()
     {
         list_add(&msgTable[i].m_list, &msgFree_h);
     }
+    initSlabCache(&msgCache, sizeof(msg_t), MAXMESSAGES);
+}
+
+/**
+ * @brief Grows the list of free messages with a new slab frame, when the static table is exhausted.
+ *
+ * @param void
+ * @return int: 1 if new messages were added to msgFree, 0 otherwise.
+ */
+static int growMsgs()
+{
+    slab_t *s = slabGrow(&msgCache);
+    if (s == NULL)
+        return 0;
+    for (unsigned int i = 0; i < msgCache.sc_perslab; i++)
+    {
+        msg_t *m = (msg_t *)slabObject(&msgCache, s, i);
+        INIT_LIST_HEAD(&m->m_sendq);
+        list_add_tail(&m->m_list, &msgFree_h);
+    }
+    return 1;
 }
 
 /**
  * @brief Inserts the element pointed to by p into the list of free messages (msgFree).
+ *            If this leaves a slab frame with no message in use, the frame may be given back.
  *
  * @param msg_t *m: Puntatore al messaggio da inserire nella lista dei messaggi liberi.
  * @return void
  */
 void freeMsg(msg_t *m)
 {
-    list_del(&m->m_list);
+    unlinkMessage(m);
     list_add_tail(&m->m_list, &msgFree_h);
+    slab_t *s = slabGive(&msgCache, m);
+    if (s != NULL)
+    { /* every message of the frame is free, so it is in msgFree */
+        for (unsigned int i = 0; i < msgCache.sc_perslab; i++)
+            list_del(&((msg_t *)slabObject(&msgCache, s, i))->m_list);
+        slabRelease(&msgCache, s);
+    }
 }
 
 /**
  * @brief Returns NULL if the list of free messages (msgFree) is empty. Otherwise, remove an element from the list of free messages,
  *            provide initial values for ALL of the messages fields and then return a pointer to the removed element. Messages get
  *            reused, so it is important that no previous value persist in a message when it gets reallocated.
+ *            An empty list is first refilled with a slab frame, if the slab pool is enabled and not exhausted.
  *
  * @param void
  * @return msg_t *: Puntatore al primo messaggio libero, oppure NULL nel caso di lista vuota.
  */
 msg_t *allocMsg()
 {
-    if (list_empty(&msgFree_h))
+    if (list_empty(&msgFree_h) && !growMsgs())
         return NULL;
     else
     {
         msg_t *nms = container_of(msgFree_h.next, msg_t, m_list);
         list_del(msgFree_h.next);
         mkEmptyMessageQ(&nms->m_list);
+        INIT_LIST_HEAD(&nms->m_sendq);
         // here we re-initialize the message
         nms->m_sender = NULL;
-        nms->m_payload = 0;
+        nms->m_senderPid = 0;
+        for (int i = 0; i < MSGWORDS; i++)
+            nms->m_words[i] = 0;
+        slabTake(&msgCache, nms);
         return nms;
     }
 }
@@ -121,7 +184,7 @@ msg_t *popMessage(struct list_head *head, pcb_PTR p_ptr)
     if (p_ptr == NULL)
     {
         nms = container_of(head->next, msg_t, m_list);
-        list_del(head->next);
+        unlinkMessage(nms);
         return nms;
     }
 
@@ -130,9 +193,9 @@ msg_t *popMessage(struct list_head *head, pcb_PTR p_ptr)
     {
         nms = container_of(iter, msg_t, m_list);
 
-        if (nms->m_sender->p_pid == p_ptr->p_pid)
+        if (nms->m_sender == p_ptr)
         {
-            list_del(&(nms->m_list));
+            unlinkMessage(nms);
             return nms;
         }
     }
@@ -154,3 +217,59 @@ msg_t *headMessage(struct list_head *head)
     else
         return container_of(head->next, msg_t, m_list);
 }
+
+/**
+ * @brief Insert the message pointed to by m at the end of the inbox of p. The message is also chained at the end of
+ *            the sender queue of its sender, so that the inbox keeps both the global FIFO order and the per-sender one.
+ *
+ * @param pcb_t *p: the process that receives the message.
+ * @param msg_t *m: the message to insert, m->m_sender must be set.
+ *
+ * @return void
+ */
+void insertInboxMessage(pcb_t *p, msg_t *m)
+{
+    if (m->m_sender != NULL) /* else the pseudo sender is already in m_senderPid */
+        m->m_senderPid = m->m_sender->p_pid;
+    list_add_tail(&m->m_list, &p->msg_inbox);
+    list_add_tail(&m->m_sendq, senderQueue(p, m->m_senderPid));
+}
+
+/**
+ * @brief Remove the first message from the inbox of p whose sender has the given pid. If pid is ANYMESSAGE, the first
+ *            message of the inbox is removed. Only the messages hashed in the same sender queue are looked at, so a
+ *            selective receive does not walk the whole inbox. Return NULL if no such message was found.
+ *
+ * @param pcb_t *p: the process that owns the inbox.
+ * @param int pid: the pid of the sender of the wanted message, ANYMESSAGE for any message.
+ *
+ * @return msg_t *: the removed message, NULL if there was none.
+ */
+msg_t *popInboxMessage(pcb_t *p, int pid)
+{
+    msg_t *nms;
+    if (pid == ANYMESSAGE)
+        return popMessage(&p->msg_inbox, NULL);
+
+    struct list_head *sq = senderQueue(p, pid);
+    list_for_each_entry(nms, sq, m_sendq)
+    {
+        if (nms->m_senderPid == pid)
+        {
+            unlinkMessage(nms);
+            return nms;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Returns the highest number of messages ever in use at the same time.
+ *
+ * @param void
+ * @return unsigned int: the high-water mark of the message cache.
+ */
+unsigned int msgHighWater()
+{
+    return msgCache.sc_highwater;
+}
@@ -2,7 +2,13 @@
 
 static pcb_t pcbTable[MAXPROC];
 LIST_HEAD(pcbFree_h);
-static int next_pid = 1;
+/* handle table: slot i holds the pcb whose p_index is i, NULL if the slot has no pcb */
+static pcb_PTR pcbIndex[MAXPCBINDEX];
+/* incarnation of every slot, bumped every time its pcb is freed; it is kept here rather than in the pcb
+   because the pcbs of a slab frame given back to the pool are lost, while their slots are not */
+static unsigned int pcbGen[MAXPCBINDEX];
+/* pcbs beyond MAXPROC are carved out of slab frames */
+static slabcache_t pcbCache;
 
 /**
  * @brief     Initializes the list of free PCBs pcbFree_h so that it contains all the elements of the static array of PCBs,
@@ -17,7 +23,40 @@ void initPcbs()
     for (int i = MAXPROC - 1; i >= 0; i--)
     {
         list_add(&pcbTable[i].p_list, &pcbFree_h);
+        pcbTable[i].p_queue = &pcbFree_h;
+        pcbTable[i].p_index = i;
+        pcbIndex[i] = &pcbTable[i];
     }
+    initSlabCache(&pcbCache, sizeof(pcb_t), MAXPROC);
+}
+
+/**
+ * @brief    Grows the list of free PCBs with a new slab frame, when the static table is exhausted.
+ *
+ * @param void
+ * @return int: 1 if new PCBs were added to pcbFree_h, 0 otherwise.
+ */
+static int growPcbs()
+{
+    slab_t *s = slabGrow(&pcbCache);
+    if (s == NULL)
+        return 0;
+    /* handle slots of a frame are fixed, right after the static table ones */
+    unsigned int base = MAXPROC + slabFrameNo(s) * pcbCache.sc_perslab;
+    if (base + pcbCache.sc_perslab > MAXPCBINDEX)
+    { /* no room left in the handle table */
+        slabRelease(&pcbCache, s);
+        return 0;
+    }
+    for (unsigned int i = 0; i < pcbCache.sc_perslab; i++)
+    {
+        pcb_PTR p = (pcb_PTR)slabObject(&pcbCache, s, i);
+        list_add_tail(&p->p_list, &pcbFree_h);
+        p->p_queue = &pcbFree_h;
+        p->p_index = base + i;
+        pcbIndex[base + i] = p;
+    }
+    return 1;
 }
 
 /**
@@ -31,10 +70,18 @@ static void initPcbValues(pcb_PTR p)
 
     // initialize the pcb structures
     INIT_LIST_HEAD(&p->p_list);
+    p->p_queue = NULL;
     p->p_parent = NULL;
     INIT_LIST_HEAD(&p->p_child);
     INIT_LIST_HEAD(&p->p_sib);
     INIT_LIST_HEAD(&p->msg_inbox);
+    for (int i = 0; i < MSGHASHSIZE; i++)
+        INIT_LIST_HEAD(&p->msg_senders[i]);
+    p->p_prio = PRIONORMAL;
+    p->p_waiting = 0;
+    p->p_waitFor = ANYMESSAGE;
+    p->p_notify = 0;
+    p->p_notifyStatus = 0;
 
     p->p_s.cause = 0;
     p->p_s.entry_hi = 0;
@@ -49,37 +96,62 @@ static void initPcbValues(pcb_PTR p)
     p->p_s.pc_epc = 0;
     p->p_s.status = 0;
     p->p_time = 0;
+    p->p_burst = 0;
+    p->p_sleepIdx = -1;
+    p->p_wakeTOD = 0;
+    p->p_ioReq = NULL;
 
-    p->p_pid = next_pid++;
+    p->p_pid = (pcbGen[p->p_index] << PIDINDEXBITS) | (p->p_index + 1);
 }
 
 /**
  * @brief     Adds a PCB to the list of free PCBs. Therefore, it inserts the element pointed to by p into the list of free PCBs (pcbFree_h).
+ *            If the PCB is still linked in some process queue (e.g. the ready queue of a killed process), it is unlinked first.
  *
  * @param pcb_t *p:  Puntatore al PCB da inserire nella lista dei PCB liberi.
  * @return void
  */
 void freePcb(pcb_t *p)
 {
+    if (p->p_queue == &pcbFree_h)
+        return;
+    if (p->p_queue != NULL)
+        list_del(&p->p_list);
     list_add_tail(&p->p_list, &pcbFree_h);
+    p->p_queue = &pcbFree_h;
+    pcbGen[p->p_index]++; /* stale handles of p will not resolve anymore, even if its slot is regrown */
+
+    slab_t *s = slabGive(&pcbCache, p);
+    if (s != NULL)
+    { /* every pcb of the frame is free, so it is in pcbFree_h */
+        for (unsigned int i = 0; i < pcbCache.sc_perslab; i++)
+        {
+            pcb_PTR fp = (pcb_PTR)slabObject(&pcbCache, s, i);
+            list_del(&fp->p_list);
+            pcbIndex[fp->p_index] = NULL;
+        }
+        slabRelease(&pcbCache, s);
+    }
 }
 
 /**
  * @brief      Returns NULL if the list of free PCBs is empty. Otherwise it allocates and returns the pointer to the first free PCB, removing it
  *             from the list of free PCBs. It is important that all fields are reinitialized, as the PCB may have been used previously.
+ *             An empty list is first refilled with a slab frame, if the slab pool is enabled and not exhausted.
  *
  * @param      void
  * @return     pcb_t *: Puntatore al primo PCB libero.
  */
 pcb_t *allocPcb()
 {
-    if (list_empty(&pcbFree_h))
+    if (list_empty(&pcbFree_h) && !growPcbs())
         return NULL;
     else
     {
         pcb_t *nPcb = container_of(pcbFree_h.next, pcb_t, p_list);
         list_del(pcbFree_h.next);
         initPcbValues(nPcb);
+        slabTake(&pcbCache, nPcb);
         return nPcb;
     }
 }
@@ -116,6 +188,7 @@ int emptyProcQ(struct list_head *head)
 void insertProcQ(struct list_head *head, pcb_t *p)
 {
     list_add_tail(&p->p_list, head); // é una coda, quindi si dovrebbe inserire dalla tail.
+    p->p_queue = head;
 }
 
 /**
@@ -148,6 +221,7 @@ pcb_t *removeProcQ(struct list_head *head)
     {
         pcb_t *first_pcb = container_of(list_next(head), pcb_t, p_list);
         list_del(&(first_pcb->p_list));
+        first_pcb->p_queue = NULL;
         return first_pcb;
     }
 }
@@ -155,6 +229,7 @@ pcb_t *removeProcQ(struct list_head *head)
 /**
  * @brief      Removes the PCB pointed to by p from the process queue pointed to by head. Returns NULL if the PCB is not present in the queue.
  *             Otherwise it returns p. It should be noted that p can point to any element of the queue.
+ *             Membership is read from p->p_queue, so no walk of the queue is needed.
  *
  * @param      list_head head *: puntatore alla testa della coda dei processi da cui bisogna rimuovere il PCB.
  * @param      pcb_t p *: puntatore al PCB da rimuovere dalla coda dei processi.
@@ -162,18 +237,11 @@ pcb_t *removeProcQ(struct list_head *head)
  */
 pcb_t *outProcQ(struct list_head *head, pcb_t *p)
 {
-    if (p == NULL)
+    if (p == NULL || p->p_queue != head)
         return NULL;
-    struct list_head *iter;
-    list_for_each(iter, head)
-    {
-        if (iter == &p->p_list)
-        {
-            list_del(iter);
-            return p;
-        }
-    }
-    return NULL;
+    list_del(&p->p_list);
+    p->p_queue = NULL;
+    return p;
 }
 
 /**
@@ -242,6 +310,7 @@ pcb_t *outChild(pcb_t *p)
 /**
  * @brief     Search a pcb pointer in a list (of pcbs).
  *            Returns 1 if the pcb is found, 0 otherwise.
+ *            The check is done on the queue tag of the pcb, in constant time.
  *
  * @param      pcb_PTR p: pointer to be found in the list.
  * @param      struct list_head *list: pointer to the list where to search the pcb.
@@ -249,38 +318,85 @@ pcb_t *outChild(pcb_t *p)
  */
 unsigned int searchProcQ(pcb_PTR p, struct list_head *list)
 {
-    if (p == NULL || list_empty(list))
-        return 0;
-    else
+    return (p != NULL && p->p_queue == list);
+}
+
+/**
+ * @brief     Returns the handle slot of the pcb at address addr, checking that addr is really the start of a pcb
+ *            of the static table or of a slab frame owned by the pcb cache.
+ *
+ * @param      memaddr addr: the candidate pcb address.
+ * @return     int: the slot index, -1 if addr is not a pcb.
+ */
+static int pcbSlotOf(memaddr addr)
+{
+    unsigned int index;
+    slab_t *s;
+    if (addr >= (memaddr)pcbTable && addr < (memaddr)&pcbTable[MAXPROC])
     {
-        pcb_PTR nPcb;
-        int i = 0;
-        list_for_each_entry(nPcb, list, p_list)
-        {
-            if (nPcb == p)
-                return 1;
-            else if (i++ > MAXPROC)
-                break;
-        }
-        return 0;
+        if ((addr - (memaddr)pcbTable) % sizeof(pcb_t) != 0)
+            return -1;
+        index = (addr - (memaddr)pcbTable) / sizeof(pcb_t);
     }
+    else if ((s = slabOf((void *)addr)) != NULL && addr >= (memaddr)(s + 1))
+    {
+        if ((addr - (memaddr)(s + 1)) % sizeof(pcb_t) != 0)
+            return -1;
+        index = MAXPROC + slabFrameNo(s) * pcbCache.sc_perslab + (addr - (memaddr)(s + 1)) / sizeof(pcb_t);
+    }
+    else
+        return -1;
+    if (index >= MAXPCBINDEX || pcbIndex[index] != (pcb_PTR)addr)
+        return -1;
+    return index;
 }
 
 /**
- * @brief     Unblocks a pcb that is blocked on a device.
- *            Returns the pcb if it is found, NULL otherwise.
+ * @brief     Resolves a process identifier into a live pcb, in constant time. The identifier can be either a pcb
+ *            address or a process handle (pid): a handle carries the slot index and the generation of the pcb, so
+ *            that a handle of a pcb that was freed, and maybe reused, does not resolve anymore.
  *
- * @param      unsigned_int devNo: device number.
- * @param      struct list_head *list: pointer to the list where to search the pcb.
- * @return     pcb_PTR: pointer to the pcb that was unblocked, NULL if not found.
+ * @param      unsigned int id: pcb address or process handle.
+ * @return     pcb_PTR: the live pcb, NULL if id does not identify an existing process.
  */
-pcb_PTR unlockPcbDevNo(unsigned int devNo, struct list_head *list)
+pcb_t *resolvePcb(unsigned int id)
 {
-    pcb_PTR nPcb;
-    list_for_each_entry(nPcb, list, p_list)
+    pcb_PTR p;
+    if (pcbSlotOf(id) >= 0)
+        p = (pcb_PTR)id;
+    else
     {
-        if (nPcb->blockedOnDevice == devNo)
-            return outProcQ(list, nPcb);
+        unsigned int slot = id & PIDINDEXMASK;
+        if (slot == 0 || slot > MAXPCBINDEX)
+            return NULL;
+        p = pcbIndex[slot - 1];
+        if (p == NULL || p->p_pid != (int)id)
+            return NULL;
     }
-    return NULL;
-}
\ No newline at end of file
+    return (p->p_queue == &pcbFree_h) ? NULL : p;
+}
+
+/**
+ * @brief     Returns the handle (pid) of a process identifier, that can be either a pcb address or a handle.
+ *            The process does not need to be alive: this is used to match messages sent before its death.
+ *
+ * @param      unsigned int id: pcb address or process handle.
+ * @return     int: the process handle.
+ */
+int resolvePid(unsigned int id)
+{
+    if (pcbSlotOf(id) >= 0)
+        return ((pcb_PTR)id)->p_pid;
+    return (int)id;
+}
+
+/**
+ * @brief     Returns the highest number of PCBs ever in use at the same time.
+ *
+ * @param     void
+ * @return    unsigned int: the high-water mark of the PCB cache.
+ */
+unsigned int pcbHighWater()
+{
+    return pcbCache.sc_highwater;
+}
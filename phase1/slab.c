@@ -0,0 +1,156 @@
+#include "./headers/slab.h"
+
+/* bit i on means that frame i of the slab pool is owned by some cache */
+static unsigned int slabFrameMap = 0;
+/* caches only grow once the nucleus has handed over the slab pool */
+static unsigned int slabGrowth = OFF;
+
+/**
+ * @brief Hands the frames of the slab pool over to the caches. Until this is called, the pcb and message
+ *        tables are limited to their static MAXPROC/MAXMESSAGES entries.
+ *
+ * @param void
+ * @return void
+ */
+void initSlabs()
+{
+    slabFrameMap = 0;
+    slabGrowth = ON;
+}
+
+/**
+ * @brief Initializes an empty cache of objects of size objsize, backed by a static table of statics objects
+ *        that are already in the free list of the caller.
+ *
+ * @param slabcache_t *c: the cache to initialize.
+ * @param unsigned int objsize: size of a single object.
+ * @param unsigned int statics: number of objects of the static table.
+ * @return void
+ */
+void initSlabCache(slabcache_t *c, unsigned int objsize, unsigned int statics)
+{
+    c->sc_objsize = objsize;
+    c->sc_perslab = (PAGESIZE - sizeof(slab_t)) / objsize;
+    INIT_LIST_HEAD(&c->sc_slabs);
+    c->sc_frames = 0;
+    c->sc_free = statics;
+    c->sc_inuse = 0;
+    c->sc_highwater = 0;
+}
+
+/**
+ * @brief Takes a free frame of the slab pool and gives it to the cache. The caller must then put the
+ *        sc_perslab objects of the frame (see slabObject) in its free list.
+ *
+ * @param slabcache_t *c: the cache that grows.
+ * @return slab_t *: the header of the new frame, NULL if growth is disabled or the pool is exhausted.
+ */
+slab_t *slabGrow(slabcache_t *c)
+{
+    if (slabGrowth == OFF)
+        return NULL;
+    for (int i = 0; i < SLABFRAMES; i++)
+    {
+        if (!(slabFrameMap & (1 << i)))
+        {
+            slab_t *s = (slab_t *)(SLABPOOLSTART + (i * PAGESIZE));
+            slabFrameMap |= (1 << i);
+            s->sl_inuse = 0;
+            list_add_tail(&s->sl_list, &c->sc_slabs);
+            c->sc_frames++;
+            c->sc_free += c->sc_perslab;
+            return s;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Returns the i-th object of a slab frame, objects are laid out right after the header.
+ *
+ * @param slabcache_t *c: the cache owning the frame.
+ * @param slab_t *s: the frame header.
+ * @param unsigned int i: index of the object, in [0, sc_perslab).
+ * @return void *: the object.
+ */
+void *slabObject(slabcache_t *c, slab_t *s, unsigned int i)
+{
+    return (void *)((memaddr)(s + 1) + (i * c->sc_objsize));
+}
+
+/**
+ * @brief Returns the frame header of an object, frames being page aligned.
+ *
+ * @param void *obj: the object.
+ * @return slab_t *: the frame header, NULL if the object belongs to a static table.
+ */
+slab_t *slabOf(void *obj)
+{
+    memaddr addr = (memaddr)obj;
+    if (addr < SLABPOOLSTART || addr >= SLABPOOLSTART + (SLABFRAMES * PAGESIZE))
+        return NULL;
+    return (slab_t *)(addr & ~(PAGESIZE - 1));
+}
+
+/**
+ * @brief Returns the position of a frame in the slab pool.
+ *
+ * @param slab_t *s: the frame header.
+ * @return unsigned int: the frame number, in [0, SLABFRAMES).
+ */
+unsigned int slabFrameNo(slab_t *s)
+{
+    return ((memaddr)s - SLABPOOLSTART) / PAGESIZE;
+}
+
+/**
+ * @brief Accounts an object that has just been allocated from the free list of the cache.
+ *
+ * @param slabcache_t *c: the cache.
+ * @param void *obj: the allocated object.
+ * @return void
+ */
+void slabTake(slabcache_t *c, void *obj)
+{
+    slab_t *s = slabOf(obj);
+    if (s != NULL)
+        s->sl_inuse++;
+    c->sc_free--;
+    if (++c->sc_inuse > c->sc_highwater)
+        c->sc_highwater = c->sc_inuse;
+}
+
+/**
+ * @brief Accounts an object that has just been put back in the free list of the cache.
+ *        When its frame becomes unused and enough free objects are left elsewhere, the frame
+ *        is returned, so that the caller unlinks its objects and calls slabRelease.
+ *
+ * @param slabcache_t *c: the cache.
+ * @param void *obj: the freed object.
+ * @return slab_t *: the frame that can be given back, NULL otherwise.
+ */
+slab_t *slabGive(slabcache_t *c, void *obj)
+{
+    slab_t *s = slabOf(obj);
+    c->sc_free++;
+    c->sc_inuse--;
+    if (s != NULL && --s->sl_inuse == 0 && c->sc_free >= c->sc_perslab + SLABSLACK)
+        return s;
+    return NULL;
+}
+
+/**
+ * @brief Gives a frame of the cache back to the slab pool. None of its objects must be
+ *        still linked in the free list of the caller.
+ *
+ * @param slabcache_t *c: the cache.
+ * @param slab_t *s: the frame to release.
+ * @return void
+ */
+void slabRelease(slabcache_t *c, slab_t *s)
+{
+    list_del(&s->sl_list);
+    c->sc_frames--;
+    c->sc_free -= c->sc_perslab;
+    slabFrameMap &= ~(1 << slabFrameNo(s));
+}
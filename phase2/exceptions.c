@@ -1,40 +1,217 @@
 #include "./headers/lib.h"
 
 /**
- * @brief Sends a message to a PCB identified by dest address. If the process is not in the system, the message is not sent.
- *        If the process is waiting for a message (so its performing a recv), it is awakened and put in the ready queue.
+ * @brief Puts a message of MSGWORDS words in the inbox of dest, without waking it up.
+ *
+ * @param senderptr the sender pcb
+ * @param destptr the destination pcb, already validated
+ * @param words the MSGWORDS words of the message
+ * @return int - 0 on success, MSGNOGOOD if no message could be allocated
+ */
+static int postMessage(pcb_PTR senderptr, pcb_PTR destptr, unsigned int *words)
+{
+    msg_PTR msg = allocMsg();
+    if (msg == NULL)
+        return MSGNOGOOD;
+    msg->m_sender = senderptr;
+    for (int i = 0; i < MSGWORDS; i++)
+        msg->m_words[i] = words[i];
+    insertInboxMessage(destptr, msg);
+    return 0;
+}
+
+/**
+ * @brief Tells if a pcb is blocked in a receive that a message from sender satisfies.
+ *        A pcb still sitting on a device or pseudo-clock queue is not woken by a message,
+ *        the interrupt handler does it once it has been removed from there.
+ *
+ * @param p the pcb
+ * @param pid the pid of the sender of the message (IOCOMPLETION for an asynchronous i/o completion)
+ * @return int - 1 if p waits for a message from sender, 0 otherwise
+ */
+static int wantsMessage(pcb_PTR p, int pid)
+{
+    return (p->p_waiting && p->p_queue == NULL &&
+            (p->p_waitFor == ANYMESSAGE || p->p_waitFor == pid));
+}
+
+/**
+ * @brief Tells if the current process has something to receive: a message or a notification.
+ *
+ * @param void
+ * @return int - 1 if the inbox or the notification word is not empty, 0 otherwise
+ */
+static int hasPending()
+{
+    return (!emptyMessageQ(&current_process->msg_inbox) || current_process->p_notify != 0);
+}
+
+/**
+ * @brief Blocks the current process in a receive, recording which sender it waits for,
+ *        so that only a matching message wakes it. The caller has to dispatch another process.
+ *
+ * @param pid the pid of the awaited sender, ANYMESSAGE for any sender
+ * @return void
+ */
+static void blockReceiver(int pid)
+{
+    current_process->p_waiting = 1;
+    current_process->p_waitFor = pid;
+    stateCpy(EXCEPTION_STATE, &current_process->p_s);
+    updatePCBTime(current_process);
+    mlfqBlock(current_process);
+}
+
+/**
+ * @brief Puts a message of MSGWORDS words in the inbox of dest and wakes dest up if it was
+ *        blocked waiting for exactly this sender (or any sender).
+ *
+ * @param senderptr the sender pcb
+ * @param destptr the destination pcb, already validated
+ * @param words the MSGWORDS words of the message
+ * @return int - 0 on success, MSGNOGOOD if no message could be allocated
+ */
+int deliverMessage(pcb_PTR senderptr, pcb_PTR destptr, unsigned int *words)
+{
+    if (postMessage(senderptr, destptr, words) != 0)
+        return MSGNOGOOD;
+    if (wantsMessage(destptr, senderptr->p_pid))
+    {
+        destptr->p_waiting = 0;
+        insertReadyQ(destptr);
+    }
+    return 0;
+}
+
+/**
+ * @brief Delivers a message allocated in advance, with sender and words already set, as deliverMessage
+ *        does. Used on the interrupt path, that cannot fail for a lack of messages.
+ *
+ * @param msg the message
+ * @param destptr the destination pcb, alive
+ * @return void
+ */
+void deliverMsg(msg_PTR msg, pcb_PTR destptr)
+{
+    insertInboxMessage(destptr, msg);
+    if (wantsMessage(destptr, msg->m_senderPid))
+    {
+        destptr->p_waiting = 0;
+        insertReadyQ(destptr);
+    }
+}
+
+/**
+ * @brief Notifies an interrupt event to a pcb just removed from a device or pseudo-clock queue.
+ *        The event is recorded in the preallocated notification word of the pcb, so this is
+ *        constant time and never fails; recv returns it as a message from the ssi.
+ *        The pcb is blocked only on this event, so it goes back in the ready queue.
+ *
+ * @param p the pcb, already removed from its queue
+ * @param event the NOTIFY* event
+ * @param status the device status, for NOTIFYDEVICE
+ * @return void
+ */
+void notify(pcb_PTR p, unsigned int event, unsigned int status)
+{
+    p->p_notify |= event;
+    if (event == NOTIFYDEVICE)
+        p->p_notifyStatus = status;
+    p->p_waiting = 0;
+    /* a requester that was preempted before its receive may still be ready, or even running */
+    if (p->p_queue == NULL && p != current_process)
+        insertReadyQ(p);
+}
+
+/**
+ * @brief Sends a message to a PCB identified by dest, either its address or its pid (process handle).
+ *        If the process is not in the system, the message is not sent.
+ *        If the process is waiting for a message from this sender (or from anyone), it is awakened and put in the ready queue.
  *        After the message is put in the inbox of the corresponding PCB, it is loaded the new state.
  *
  * @param sender the address of sender pcb
- * @param dest the address of destination pcb - register a1 content
+ * @param dest the address or the pid of destination pcb - register a1 content
  * @param payload the address of the payload to be sent - register a2 content
  * @return int
  */
 int send(unsigned int sender, unsigned int dest, unsigned int payload)
 {
-    msg_PTR msg = allocMsg();
-    if (msg == NULL)
-        return MSGNOGOOD;
+    unsigned int words[MSGWORDS] = {payload, 0, 0, 0};
+    return sendWords(sender, dest, words);
+}
+
+/**
+ * @brief Sends a message of MSGWORDS words, stored inline in the message, to a PCB identified by dest.
+ *        This is the common path of SENDMESSAGE and SENDREGMESSAGE.
+ *
+ * @param sender the address of sender pcb
+ * @param dest the address or the pid of destination pcb
+ * @param words the MSGWORDS words of the message
+ * @return int
+ */
+int sendWords(unsigned int sender, unsigned int dest, unsigned int *words)
+{
+    /* dest is validated in constant time, a stale pid of a reused pcb is rejected too */
+    pcb_PTR destptr = resolvePcb(dest);
+    if (destptr == NULL)
+        return DEST_NOT_EXIST;
 
     /* parameter comes in memory address form cause they're taken from the registers,
-    so we need to do a casting for both. */
-    pcb_PTR senderptr = (pcb_PTR)sender;
-    pcb_PTR destptr = (pcb_PTR)dest;
+    so we need to do a casting. dest is awakened only if it was waiting for this message */
+    /* providing 0 as returning value to identify a successful send operation */
+    return deliverMessage((pcb_PTR)sender, destptr, words);
+}
 
-    msg->m_sender = senderptr;
-    msg->m_payload = payload;
+/**
+ * @brief Takes the message the current process is asking for. Pending notifications count as
+ *        messages from the ssi and come first. If there is nothing, the process is
+ *        blocked and the scheduler is called, so this returns only with a message.
+ *
+ * @param sender the sender PCB address or pid, ANYMESSAGE for any sender
+ * @param words where the MSGWORDS words of the message are copied
+ * @return pcb_PTR the sender of the message
+ */
+static pcb_PTR takeMessage(unsigned int sender, unsigned int *words)
+{
+    /* messages are matched on the sender pid, the sender may even be dead by now */
+    int pid = (sender == ANYMESSAGE) ? ANYMESSAGE : resolvePid(sender);
+    pcb_PTR senderptr;
+    msg_PTR msg;
 
-    if (searchProcQ(destptr, &pcbFree_h))
-        return DEST_NOT_EXIST;
-    else if ((destptr != current_process) && !searchProcQ(destptr, &readyQueue))
-        insertProcQ(&readyQueue, destptr);  /* if dest was waiting for a message, we awaken it*/
-    insertMessage(&destptr->msg_inbox, msg);
-    /* providing 0 as returning value to identify a successful send operation */
-    return 0;
+    for (int i = 0; i < MSGWORDS; i++)
+        words[i] = 0;
+    if (current_process->p_notify != 0 && (pid == ANYMESSAGE || pid == ssi_pcb->p_pid))
+    { /* device status first, then the pseudo-clock tick */
+        if (current_process->p_notify & NOTIFYDEVICE)
+        {
+            current_process->p_notify &= ~NOTIFYDEVICE;
+            words[0] = current_process->p_notifyStatus;
+        }
+        else
+            current_process->p_notify &= ~NOTIFYCLOCK;
+        return ssi_pcb;
+    }
+
+    msg = popInboxMessage(current_process, pid);
+    if (msg == NULL)
+    { /* so there aren't any message in the inbox */
+        blockReceiver(pid);
+        scheduler();
+    }
+    /* m_sender may be stale, the pid does not resolve once the sender is freed (NULL sender);
+    an asynchronous i/o completion has no sender pcb, but its own pseudo sender */
+    if (msg->m_senderPid == (int)IOCOMPLETION)
+        senderptr = (pcb_PTR)IOCOMPLETION;
+    else
+        senderptr = resolvePcb(msg->m_senderPid);
+    for (int i = 0; i < MSGWORDS; i++)
+        words[i] = msg->m_words[i];
+    freeMsg(msg);
+    return senderptr;
 }
 
 /**
- * @brief Receives a message from a PCB identified by sender address. If the process is not in the system, the message is not received.
+ * @brief Receives a message from a PCB identified by sender address or pid. If the process is not in the system, the message is not received.
  *        If the process find no message, it is put in the waiting queue by calling the scheduler.
  *        After the message is received, it is loaded the new state.
  *        After the recv, in v0 there will be the sender address and in a2 the payload.
@@ -45,31 +222,114 @@ int send(unsigned int sender, unsigned int dest, unsigned int payload)
  */
 void recv(unsigned int sender, unsigned int payload)
 {
-    /* parameter comes from the registers in memory address form, so we need to do a casting */
-    pcb_PTR senderptr = (pcb_PTR)sender;
-    msg_PTR msg;
+    unsigned int words[MSGWORDS];
+    /* putting sender address in v0 register as returning value of recv */
+    EXCEPTION_STATE->reg_v0 = (unsigned int)takeMessage(sender, words);
+    if (payload != 0)
+    { /* we check if the payload should be ignored */
+        unsigned int *recvd = (unsigned int *)payload;
+        *recvd = words[0];
+    }
+}
 
-    if (sender == ANYMESSAGE)
-        msg = popMessage(&current_process->msg_inbox, NULL);
-    else
-        msg = popMessage(&current_process->msg_inbox, senderptr);
+/**
+ * @brief Receives a message from a PCB identified by sender address or pid, returning its words in registers
+ *        (RECEIVEREGMESSAGE): v0 gets the sender address, the words go in a2, a3, a1 and v1.
+ *        So the receiver gets the whole message without reading the memory of the sender.
+ *
+ * @param sender the sender PCB address
+ * @return void
+ */
+void recvRegs(unsigned int sender)
+{
+    unsigned int words[MSGWORDS];
+    EXCEPTION_STATE->reg_v0 = (unsigned int)takeMessage(sender, words);
+    EXCEPTION_STATE->reg_a2 = words[0];
+    EXCEPTION_STATE->reg_a3 = words[1];
+    EXCEPTION_STATE->reg_a1 = words[2];
+    EXCEPTION_STATE->reg_v1 = words[3];
+}
 
-    if (msg == NULL)
-    { /* so there aren't any message in the inbox */
-        stateCpy(EXCEPTION_STATE, &current_process->p_s);
-        updatePCBTime(current_process);
-        scheduler();
+/**
+ * @brief Sends the request in a2, a3, v0, v1 to dest and waits for its reply (CALLMESSAGE).
+ *        From now on the caller is a RECEIVEREGMESSAGE from dest: if it blocks, its syscall
+ *        is re-executed as such when it is dispatched again. If dest is waiting for a message,
+ *        the nucleus switches straight to it, donating the rest of the time slice of the caller,
+ *        instead of going through the ready queue.
+ *
+ * @param dest the address or pid of the destination pcb - register a1 content
+ * @return void
+ */
+void call(unsigned int dest)
+{
+    unsigned int words[MSGWORDS] = {EXCEPTION_STATE->reg_a2, EXCEPTION_STATE->reg_a3,
+                                    EXCEPTION_STATE->reg_v0, EXCEPTION_STATE->reg_v1};
+    pcb_PTR destptr = resolvePcb(dest);
+    if (destptr == NULL)
+    {
+        EXCEPTION_STATE->reg_v0 = DEST_NOT_EXIST;
+        return;
     }
-    else
-    { /* putting sender address in v0 register as returning value of recv */
-        EXCEPTION_STATE->reg_v0 = (unsigned int)msg->m_sender;
-        if (payload != 0)
-        { /* we check if the payload should be ignored */
-            unsigned int *recvd = (unsigned int *)payload;
-            *recvd = msg->m_payload;
+    if (postMessage(current_process, destptr, words) != 0)
+    {
+        EXCEPTION_STATE->reg_v0 = MSGNOGOOD;
+        return;
+    }
+
+    EXCEPTION_STATE->reg_a0 = RECEIVEREGMESSAGE;
+    EXCEPTION_STATE->reg_a1 = (unsigned int)destptr;
+    if (!wantsMessage(destptr, current_process->p_pid) || hasPending())
+    { /* dest is not waiting for us (running, blocked on a device or on someone else),
+         or a reply may already be there */
+        if (wantsMessage(destptr, current_process->p_pid))
+        {
+            destptr->p_waiting = 0;
+            insertReadyQ(destptr);
+        }
+        recvRegs((unsigned int)destptr);
+        return;
+    }
+    /* direct handoff: the caller blocks waiting for the reply and dest runs on its time slice */
+    blockReceiver(destptr->p_pid);
+    destptr->p_waiting = 0;
+    switchTo(destptr);
+}
+
+/**
+ * @brief Replies with the words in a2, a3, v0, v1 to the client and then receives the next
+ *        message from any sender (REPLYRECVMESSAGE). From now on the server is a RECEIVEREGMESSAGE
+ *        from any sender. If no message is pending, the server blocks and the nucleus switches
+ *        straight to the client, if it was waiting for the reply.
+ *
+ * @param client the address or pid of the pcb to reply to - register a1 content
+ * @return void
+ */
+void replyRecv(unsigned int client)
+{
+    unsigned int words[MSGWORDS] = {EXCEPTION_STATE->reg_a2, EXCEPTION_STATE->reg_a3,
+                                    EXCEPTION_STATE->reg_v0, EXCEPTION_STATE->reg_v1};
+    /* a dead client, or a full message table, does not stop the server from receiving */
+    pcb_PTR clientptr = resolvePcb(client);
+    if (clientptr != NULL && postMessage(current_process, clientptr, words) != 0)
+        clientptr = NULL;
+
+    EXCEPTION_STATE->reg_a0 = RECEIVEREGMESSAGE;
+    EXCEPTION_STATE->reg_a1 = ANYMESSAGE;
+    if (hasPending() || clientptr == NULL ||
+        !wantsMessage(clientptr, current_process->p_pid))
+    { /* the server goes on with the next request, the client is scheduled as usual */
+        if (clientptr != NULL && wantsMessage(clientptr, current_process->p_pid))
+        {
+            clientptr->p_waiting = 0;
+            insertReadyQ(clientptr);
         }
-        freeMsg(msg);
+        recvRegs(ANYMESSAGE);
+        return;
     }
+    /* direct handoff: the server blocks for the next request and the client runs on its time slice */
+    blockReceiver(ANYMESSAGE);
+    clientptr->p_waiting = 0;
+    switchTo(clientptr);
 }
 
 /**
@@ -83,7 +343,7 @@ void syscallHandler()
 {
     /* Information is stored in a0, a1, a2, a3 general purpose registers.
     Futhermore, a SYSCALL request can be only done in kernel-mode, and only if a0 contained
-    a value in the range [-1...-2]/  */
+    a value in the range [-1...-9]/  */
 
     /* We check if the processor is in kernel mode looking up at the bit 1 (of 31) of the status register:
     if is 0, then is in Kernel mode, else it's in user mode. */
@@ -109,6 +369,46 @@ void syscallHandler()
             EXCEPTION_STATE->pc_epc += WORDLEN;
             LDST(EXCEPTION_STATE);
             break;
+        case SENDREGMESSAGE:
+        { /* words are read before v0 gets the return value */
+            unsigned int words[MSGWORDS] = {EXCEPTION_STATE->reg_a2, EXCEPTION_STATE->reg_a3,
+                                            EXCEPTION_STATE->reg_v0, EXCEPTION_STATE->reg_v1};
+            EXCEPTION_STATE->reg_v0 = sendWords((memaddr)current_process, EXCEPTION_STATE->reg_a1, words);
+            EXCEPTION_STATE->pc_epc += WORDLEN;
+            LDST(EXCEPTION_STATE);
+            break;
+        }
+        case RECEIVEREGMESSAGE:
+            recvRegs(EXCEPTION_STATE->reg_a1);
+            EXCEPTION_STATE->pc_epc += WORDLEN;
+            LDST(EXCEPTION_STATE);
+            break;
+        case CALLMESSAGE:
+            call(EXCEPTION_STATE->reg_a1);
+            EXCEPTION_STATE->pc_epc += WORDLEN;
+            LDST(EXCEPTION_STATE);
+            break;
+        case REPLYRECVMESSAGE:
+            replyRecv(EXCEPTION_STATE->reg_a1);
+            EXCEPTION_STATE->pc_epc += WORDLEN;
+            LDST(EXCEPTION_STATE);
+            break;
+        case FASTGETTIME: /* the time is brought up to date, so it includes the current slice */
+            updatePCBTime(current_process);
+            EXCEPTION_STATE->reg_v0 = getCPUTime(current_process);
+            EXCEPTION_STATE->pc_epc += WORDLEN;
+            LDST(EXCEPTION_STATE);
+            break;
+        case FASTGETPROCESSID:
+            EXCEPTION_STATE->reg_v0 = getProcessID(current_process, (pcb_PTR)EXCEPTION_STATE->reg_a1);
+            EXCEPTION_STATE->pc_epc += WORDLEN;
+            LDST(EXCEPTION_STATE);
+            break;
+        case FASTGETSUPPORTPTR:
+            EXCEPTION_STATE->reg_v0 = getSupportData(current_process);
+            EXCEPTION_STATE->pc_epc += WORDLEN;
+            LDST(EXCEPTION_STATE);
+            break;
         default: /* trap vector*/
             passUpOrDie(GENERALEXCEPT);
         }
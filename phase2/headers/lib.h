@@ -16,15 +16,23 @@ extern void klog_print_dec(unsigned int);
 
 /* -- MACROS -- */
 #define EXCEPTION_STATE ((state_t * )BIOSDATAPAGE)
+/* a message word below RAMSTART is a service code rather than a pointer to a payload struct */
+#define ISSERVICECODE(w) ((unsigned int)(w) < RAMSTART)
+/* the TOD clock counts TIMESCALE ticks per microsecond, while LDIT and the constants are in microseconds */
+#define TIMESCALE (*((cpu_t *)TIMESCALEADDR))
+#define TODTICKS(us) ((us) * TIMESCALE)
 
 /* -- VARIABLES -- */
 extern unsigned int processCount, softBlockCount;
 extern pcb_PTR current_process;
 extern unsigned int startTOD;
-extern struct list_head readyQueue;
+extern unsigned int tickBase;
+extern struct list_head readyQueue[NPRIO];
+extern unsigned int readyBitmap;
 
-/* we need one list of blocked pcb for every device, each one described in Section 5 in uMPS3 - Principles of Operation */
-extern struct list_head blockedDiskQueue, blockedFlashQueue, blockedEthernetQueue, blockedPrinterQueue, blockedTerminalTransmQueue,blockedTerminalRecvQueue;
+/* one FIFO of DoIO requests (iorequest_t) for every (sub)device, each one described in Section 5 in uMPS3 - Principles of Operation */
+extern struct list_head deviceQueue[NDEVLINES][N_DEV_PER_IL][NSUBDEV];
+#define DEVQUEUE(line, dev, sub) (&deviceQueue[(line) - DEV_IL_START][dev][sub])
 extern struct list_head pseudoClockQueue;
 extern struct list_head pcbFree_h;
 
@@ -47,11 +55,18 @@ extern void uTLB_RefillHandler();
 /* ssi module*/
 void SSI();
 unsigned int SSIRequest(pcb_PTR, unsigned int, void*);
+unsigned int SSIRegRequest(pcb_PTR, unsigned int *);
 unsigned int createProcess(pcb_PTR, ssi_create_process_PTR);
 unsigned int isPcbBlockedOnDevice(pcb_PTR);
 void terminateProcess(pcb_PTR);
-void doio(ssi_do_io_PTR, pcb_PTR);
-void insertDeviceQ(unsigned int, pcb_PTR);
+int doio(ssi_do_io_PTR, pcb_PTR);
+void initDevDescs();
+void initIoRequests();
+unsigned int doioAsync(ssi_do_io_PTR, pcb_PTR);
+int doioString(ssi_do_io_string_PTR, pcb_PTR);
+int readLine(ssi_do_io_string_PTR, pcb_PTR, unsigned int *);
+void completeIo(unsigned int, unsigned int, unsigned int, unsigned int);
+int ioCancel(pcb_PTR);
 void wait4Clock(pcb_PTR);
 unsigned int getSupportData(pcb_PTR);
 unsigned int getProcessID(pcb_PTR, pcb_PTR);
@@ -64,25 +79,158 @@ void updatePCBTime(pcb_PTR);
 void exceptionHandler();
 void syscallHandler();
 int send(unsigned int, unsigned int, unsigned int);
+int deliverMessage(pcb_PTR, pcb_PTR, unsigned int *);
+void notify(pcb_PTR, unsigned int, unsigned int);
+void deliverMsg(msg_PTR, pcb_PTR);
+int sendWords(unsigned int, unsigned int, unsigned int *);
 void recv(unsigned int, unsigned int);
+void recvRegs(unsigned int);
+void call(unsigned int);
+void replyRecv(unsigned int);
 void passUpOrDie(unsigned int);
 
 /* interrupt module */
 void interruptHandler();
 void PLTHandler();
 void intervalTimerHandler();
+void armPseudoClock();
+void armIntervalTimer();
+
+/* sleep module */
+int sleepUntil(pcb_PTR, unsigned int);
+int sleepCancel(pcb_PTR);
+void wakeSleepers(unsigned int);
+int nextSleepTOD(unsigned int *);
+
+/* terminal input module */
+int termInArmed(unsigned int);
+int termInRead(unsigned int, pcb_PTR, char *, unsigned int, unsigned int *);
+int termInCancel(pcb_PTR);
+void termInChar(unsigned int, unsigned int);
 unsigned int getDeviceBitmap(unsigned int);
-unsigned int getDeviceNo(unsigned int);
 void deviceHandler(unsigned int);
 // void deviceHandler4DEBUG(unsigned int);
-pcb_PTR unlockPcbDevNo(unsigned int, struct list_head *); /* defined in pcb.c*/
-pcb_PTR getPcbFromLine(unsigned int, unsigned int);
 void exitInterruptHandler();
 
 /* scheduler module */
 void scheduler();
+void switchTo(pcb_PTR);
+void insertReadyQ(pcb_PTR);
+pcb_PTR removeReadyQ();
+pcb_PTR outReadyQ(pcb_PTR);
+void mlfqAdmit(pcb_PTR);
+void mlfqExpire(pcb_PTR);
+void mlfqBlock(pcb_PTR);
+void mlfqBoost();
 
 /* misc */
 unsigned int searchProcQ(pcb_PTR, struct list_head *);
 
+/**
+ * @brief Sends a message of MSGWORDS words to dest, passing them in registers (SENDREGMESSAGE).
+ *        libumps SYSCALL only sets a0-a3, so v0 and v1 are loaded here.
+ *
+ * @param dest the address or pid of the destination pcb
+ * @param w0..w3 the words of the message
+ * @return int - 0 on success, MSGNOGOOD or DEST_NOT_EXIST otherwise
+ */
+static inline int sendRegMessage(unsigned int dest, unsigned int w0, unsigned int w1, unsigned int w2, unsigned int w3)
+{
+    register unsigned int a0 __asm__("$4") = SENDREGMESSAGE;
+    register unsigned int a1 __asm__("$5") = dest;
+    register unsigned int a2 __asm__("$6") = w0;
+    register unsigned int a3 __asm__("$7") = w1;
+    register unsigned int v0 __asm__("$2") = w2;
+    register unsigned int v1 __asm__("$3") = w3;
+    __asm__ __volatile__("syscall"
+                         : "+r"(v0), "+r"(v1)
+                         : "r"(a0), "r"(a1), "r"(a2), "r"(a3)
+                         : "memory");
+    return v0;
+}
+
+/**
+ * @brief Receives a message of MSGWORDS words from sender (or ANYMESSAGE), passed back in registers (RECEIVEREGMESSAGE).
+ *        A message sent with SENDMESSAGE has its payload in words[0] and zeroes in the others.
+ *
+ * @param sender the address or pid of the sender pcb, ANYMESSAGE for any
+ * @param words the MSGWORDS words of the message received
+ * @return unsigned int - the address of the sender pcb
+ */
+static inline unsigned int recvRegMessage(unsigned int sender, unsigned int *words)
+{
+    register unsigned int a0 __asm__("$4") = RECEIVEREGMESSAGE;
+    register unsigned int a1 __asm__("$5") = sender;
+    register unsigned int a2 __asm__("$6");
+    register unsigned int a3 __asm__("$7");
+    register unsigned int v0 __asm__("$2");
+    register unsigned int v1 __asm__("$3");
+    __asm__ __volatile__("syscall"
+                         : "=r"(v0), "=r"(v1), "+r"(a1), "=r"(a2), "=r"(a3)
+                         : "r"(a0)
+                         : "memory");
+    words[0] = a2;
+    words[1] = a3;
+    words[2] = a1;
+    words[3] = v1;
+    return v0;
+}
+
+/**
+ * @brief Sends a request of MSGWORDS words to dest and waits for its reply, in a single syscall (CALLMESSAGE).
+ *        If dest is waiting for a message, the nucleus switches straight to it.
+ *
+ * @param dest the address or pid of the destination pcb
+ * @param w0..w3 the words of the request
+ * @param reply the MSGWORDS words of the reply
+ * @return unsigned int - the address of the replying pcb, or MSGNOGOOD/DEST_NOT_EXIST if the request was not sent
+ */
+static inline unsigned int callMessage(unsigned int dest, unsigned int w0, unsigned int w1, unsigned int w2,
+                                       unsigned int w3, unsigned int *reply)
+{
+    register unsigned int a0 __asm__("$4") = CALLMESSAGE;
+    register unsigned int a1 __asm__("$5") = dest;
+    register unsigned int a2 __asm__("$6") = w0;
+    register unsigned int a3 __asm__("$7") = w1;
+    register unsigned int v0 __asm__("$2") = w2;
+    register unsigned int v1 __asm__("$3") = w3;
+    __asm__ __volatile__("syscall"
+                         : "+r"(v0), "+r"(v1), "+r"(a0), "+r"(a1), "+r"(a2), "+r"(a3)
+                         :
+                         : "memory");
+    reply[0] = a2;
+    reply[1] = a3;
+    reply[2] = a1;
+    reply[3] = v1;
+    return v0;
+}
+
+/**
+ * @brief Replies to client and then receives the next message from any sender, in a single syscall (REPLYRECVMESSAGE).
+ *        If no message is pending, the nucleus switches straight to the client.
+ *
+ * @param client the address or pid of the pcb to reply to
+ * @param reply the single word of the reply
+ * @param words the MSGWORDS words of the next message received
+ * @return unsigned int - the address of the sender of the next message
+ */
+static inline unsigned int replyRecvMessage(unsigned int client, unsigned int reply, unsigned int *words)
+{
+    register unsigned int a0 __asm__("$4") = REPLYRECVMESSAGE;
+    register unsigned int a1 __asm__("$5") = client;
+    register unsigned int a2 __asm__("$6") = reply;
+    register unsigned int a3 __asm__("$7") = 0;
+    register unsigned int v0 __asm__("$2") = 0;
+    register unsigned int v1 __asm__("$3") = 0;
+    __asm__ __volatile__("syscall"
+                         : "+r"(v0), "+r"(v1), "+r"(a0), "+r"(a1), "+r"(a2), "+r"(a3)
+                         :
+                         : "memory");
+    words[0] = a2;
+    words[1] = a3;
+    words[2] = a1;
+    words[3] = v1;
+    return v0;
+}
+
 #endif
@@ -5,13 +5,16 @@ unsigned int processCount;
 /* counter of processes blocked for any reasons, allow the scheduler to track deadlock and wait4clock situation */
 unsigned int softBlockCount;
 unsigned int startTOD;
+/* TOD of the pseudo-clock phase, ticks fall on tickBase + k * TODTICKS(PSECOND) */
+unsigned int tickBase;
 
-/* Queue of PCBs that are in READY state */
-struct list_head readyQueue;
-/* Queues of PCBs that are blocked in terminal devices */
-struct list_head blockedDiskQueue, blockedFlashQueue, blockedEthernetQueue, blockedPrinterQueue;
-/* Queues of PCBs that are blocked in non-terminal device, transm or recv*/
-struct list_head blockedTerminalTransmQueue, blockedTerminalRecvQueue;
+/* Queues of PCBs that are in READY state, one per priority */
+struct list_head readyQueue[NPRIO];
+/* bit i is set when readyQueue[i] is not empty */
+unsigned int readyBitmap;
+/* FIFO queues of the DoIO requests (iorequest_t) of a (sub)device, indexed by line, device number
+and subdevice (transm or recv for terminals, SUBDEVTRANSM only for the others); the head is in flight */
+struct list_head deviceQueue[NDEVLINES][N_DEV_PER_IL][NSUBDEV];
 /* Queue of PCBs that are waiting for a WaitForClock service */
 struct list_head pseudoClockQueue;
 pcb_PTR ssi_pcb, new_pcb;
@@ -52,26 +55,32 @@ int main()
   /* Initialize the structures defined in phase1 */
   initPcbs();
   initMsgs();
+  /* let the pcb and message tables grow on the free frames of the slab pool */
+  initSlabs();
 
   /* Global variables initializations */
   processCount = 0;
   softBlockCount = 0;
   current_process = NULL;
 
-  mkEmptyProcQ(&readyQueue);
-  /* Blocked PCBs Queues */
-  /* blocked PCBs for each external (sub)device*/
-  mkEmptyProcQ(&blockedDiskQueue);
-  mkEmptyProcQ(&blockedFlashQueue);
-  mkEmptyProcQ(&blockedEthernetQueue);
-  mkEmptyProcQ(&blockedPrinterQueue);
-  mkEmptyProcQ(&blockedTerminalTransmQueue);
-  mkEmptyProcQ(&blockedTerminalRecvQueue);
+  for (int i = 0; i < NPRIO; i++)
+    mkEmptyProcQ(&readyQueue[i]);
+  readyBitmap = 0;
+  /* DoIO request queues for each external (sub)device */
+  for (int line = 0; line < NDEVLINES; line++)
+    for (int dev = 0; dev < N_DEV_PER_IL; dev++)
+      for (int sub = 0; sub < NSUBDEV; sub++)
+        INIT_LIST_HEAD(&deviceQueue[line][dev][sub]);
+  /* DoIO finds the queue of a device from its command address */
+  initDevDescs();
+  initIoRequests();
   /* queue of waiting PCBs that requested a WaitForClock service to the SSI */
   mkEmptyProcQ(&pseudoClockQueue);
 
-  /* Load system-wide interval timer with 100000 ms */
-  LDIT(PSECOND);
+  /* The interval timer is armed only when someone waits for the pseudo-clock,
+     the ticks stay aligned to 100 ms boundaries counted from here */
+  tickBase = getTOD();
+  *((unsigned int *)INTERVALTMR) = ITDISARM;
 
   /* Instantiate the first PCB, the SSI with pid 1
        This one need to have interrupts enabled, kernel-mode on, the SP set to RAMTOP
@@ -86,7 +95,8 @@ int main()
   ssi_pcb->p_s.status = ALLOFF | IEPON | IMON; /* kernel mode is by default when KUc = 0 */
   RAMTOP(ssi_pcb->p_s.reg_sp);
   ssi_pcb->p_s.pc_epc = ssi_pcb->p_s.reg_t9 = (memaddr)SSI;
-  insertProcQ(&readyQueue, ssi_pcb);
+  ssi_pcb->p_prio = PRIOSERVER; /* clients wait on it, so it runs first */
+  insertReadyQ(ssi_pcb);
   processCount++;
 
   /* Instantiate the test PCB, with pid 2
@@ -98,7 +108,8 @@ int main()
   RAMTOP(new_pcb->p_s.reg_sp);
   new_pcb->p_s.reg_sp -= 2 * PAGESIZE; /* i think this is FRAMESIZE according to specs */
   new_pcb->p_s.pc_epc = new_pcb->p_s.reg_t9 = (memaddr)test;
-  insertProcQ(&readyQueue, new_pcb);
+  mlfqAdmit(new_pcb);
+  insertReadyQ(new_pcb);
   processCount++;
 
   /* Call the scheduler */
@@ -15,103 +15,103 @@ void PLTHandler()
     they acknowledged by writing a new value into the CP0 Timer register */
     setPLT(0);
     updatePCBTime(current_process);
-    stateCpy(&current_process->p_s, EXCEPTION_STATE);
-    insertProcQ(&readyQueue, current_process);
+    stateCpy(EXCEPTION_STATE, &current_process->p_s);
+    mlfqExpire(current_process);
+    insertReadyQ(current_process);
     scheduler();
 }
 
+/* TOD of the pseudo-clock tick the processes in pseudoClockQueue wait for */
+static unsigned int clockDeadline;
+
 /**
- * @brief The interval timer interrupt is used to wake up processes that are waiting for a pseudo-clock tick.
- *        The interval timer is set to 100 milliseconds, so every 100 milliseconds the interrupt is triggered.
- *        To wait for this pseudo-clock tick, the process is put in the queue requesting a WaitForClock service.
- *        This type of interrupts are always on interrupt line 2.
+ * @brief Programs the interval timer for the nearest deadline: the pseudo-clock tick, if someone waits
+ *        for it, or the earliest wake-up of a sleeping pcb. With no deadline at all, the timer is only
+ *        acked. Writing the timer always acks a pending interrupt.
  *
  * @param void
  * @return void
  */
-void intervalTimerHandler()
+void armIntervalTimer()
 {
-    pcb_PTR awknPcb;
-    LDIT(PSECOND); /* we ack the interrupt loading 100 milliseconds in the IT */
-    awknPcb = removeProcQ(&pseudoClockQueue);
+    unsigned int now = getTOD(), deadline, sleepTOD;
+    int armed = 0;
 
-    /* unlock all PCBs waiting a pseudo-clock tick in the queue */
-    while (awknPcb != NULL)
-    { /* sender is not needed to be current_process, it can be ssi_pcb too */
-        msg_PTR msg = allocMsg();
-        msg->m_sender = ssi_pcb;
-        msg->m_payload = 0;
-        insertMessage(&awknPcb->msg_inbox, msg);
-        insertProcQ(&readyQueue, awknPcb);
-        softBlockCount--;
-        awknPcb = removeProcQ(&pseudoClockQueue);
+    if (!emptyProcQ(&pseudoClockQueue))
+    {
+        deadline = clockDeadline;
+        armed = 1;
     }
-    exitInterruptHandler();
+    if (nextSleepTOD(&sleepTOD) && (!armed || (int)(sleepTOD - deadline) < 0))
+    {
+        deadline = sleepTOD;
+        armed = 1;
+    }
+
+    if (!armed)
+        *((unsigned int *)INTERVALTMR) = ITDISARM;
+    else if ((int)(deadline - now) < TIMESCALE) /* already due, interrupt as soon as possible */
+        LDIT(1);
+    else /* LDIT takes microseconds */
+        LDIT((deadline - now) / TIMESCALE);
 }
 
 /**
- * @brief Get the device bitmap corresponding to the interrupt line.
- *        When bit i (corresponding to device i) in word j (corresponding to interrupt line j) is 1
- *        then the device i attached to interrupt line j + 3
+ * @brief Sets the pseudo-clock deadline to the next 100 milliseconds boundary counted from tickBase,
+ *        and programs the interval timer. Called when the first process starts waiting for it.
  *
- * @param interruptLine the numer of the interrupt line.
- * @return bitmap corresponding to interrupt line.
+ * @param void
+ * @return void
  */
-unsigned int getDeviceBitmap(unsigned int interruptLine)
+void armPseudoClock()
 {
-    devregarea_t *devRegArea = (devregarea_t *)BUS_REG_RAM_BASE;
-    return devRegArea->interrupt_dev[interruptLine - 3];
+    unsigned int now = getTOD();
+    clockDeadline = now + TODTICKS(PSECOND) - (now - tickBase) % TODTICKS(PSECOND);
+    armIntervalTimer();
 }
 
 /**
- * @brief Get the device number corresponding to the device bitmap.
+ * @brief The interval timer interrupt is used to wake up processes that are waiting for a pseudo-clock tick,
+ *        or sleeping until some TOD. The interval timer is armed only while someone waits, for the nearest
+ *        deadline: the next 100 milliseconds boundary or the earliest wake-up.
+ *        To wait for this pseudo-clock tick, the process is put in the queue requesting a WaitForClock service.
+ *        This type of interrupts are always on interrupt line 2.
  *
- * @param mask the bitmap of the device.
- * @return the device number.
+ * @param void
+ * @return void
  */
-unsigned int getDeviceNo(unsigned int mask)
+void intervalTimerHandler()
 {
-    if (mask & DEV7ON)
-        return 7;
-    else if (mask & DEV6ON)
-        return 6;
-    else if (mask & DEV5ON)
-        return 5;
-    else if (mask & DEV4ON)
-        return 4;
-    else if (mask & DEV3ON)
-        return 3;
-    else if (mask & DEV2ON)
-        return 2;
-    else if (mask & DEV1ON)
-        return 1;
-    else if (mask & DEV0ON)
-        return 0;
-    return -1;
+    unsigned int now = getTOD();
+
+    /* unlock all PCBs waiting a pseudo-clock tick in the queue, if the tick is due */
+    if (!emptyProcQ(&pseudoClockQueue) && (int)(now - clockDeadline) >= 0)
+    {
+        pcb_PTR awknPcb = removeProcQ(&pseudoClockQueue);
+        while (awknPcb != NULL)
+        { /* the tick is received as a message from ssi_pcb, without allocating one */
+            notify(awknPcb, NOTIFYCLOCK, 0);
+            softBlockCount--;
+            awknPcb = removeProcQ(&pseudoClockQueue);
+        }
+    }
+    wakeSleepers(now);
+    /* we ack the interrupt programming the next deadline, if any */
+    armIntervalTimer();
 }
 
 /**
- * @brief Get the PCB from the blocked queue corresponding to the interrupt line number.
+ * @brief Get the device bitmap corresponding to the interrupt line.
+ *        When bit i (corresponding to device i) in word j (corresponding to interrupt line j) is 1
+ *        then the device i attached to interrupt line j + 3
  *
- * @param interruptLine the interrupt line.
- * @param devNo the device number.
- * @return the PCB from the blocked queue.
+ * @param interruptLine the numer of the interrupt line.
+ * @return bitmap corresponding to interrupt line.
  */
-pcb_PTR getPcbFromLine(unsigned int interruptLine, unsigned int devNo)
+unsigned int getDeviceBitmap(unsigned int interruptLine)
 {
-    switch (interruptLine)
-    {
-    case IL_DISK:
-        return unlockPcbDevNo(devNo, &blockedDiskQueue);
-    case IL_FLASH:
-        return unlockPcbDevNo(devNo, &blockedFlashQueue);
-    case IL_ETHERNET:
-        return unlockPcbDevNo(devNo, &blockedEthernetQueue);
-    case IL_PRINTER:
-        return unlockPcbDevNo(devNo, &blockedPrinterQueue);
-    default:
-        return NULL;
-    }
+    devregarea_t *devRegArea = (devregarea_t *)BUS_REG_RAM_BASE;
+    return devRegArea->interrupt_dev[interruptLine - 3];
 }
 
 /**
@@ -129,63 +129,71 @@ void exitInterruptHandler()
 }
 
 /**
- * @brief Calculate the interrupt line, corresponding subdevice and send ack to the device.
+ * @brief Tells if a terminal subdevice has completed its command, that is its status byte shows
+ *        neither an idle nor a busy subdevice (a character transmitted/received, or an error).
+ *
+ * @param status the status register of the subdevice
+ * @return int - 1 if the subdevice has an interrupt pending
+ */
+static int termDone(unsigned int status)
+{
+    unsigned int code = status & TERMSTATMASK;
+    return (code != DEVREADY && code != DEVBUSY);
+}
+
+/**
+ * @brief Handles every device with an interrupt pending on the line: for each one the status is read,
+ *        the interrupt is acknowledged and the request is completed. For a terminal both subdevices
+ *        are served, the transmitter first. The caller reschedules once for all of them.
  *
  * @param interruptLine the device line on which the interrupt is triggered
  * @return void
  */
 void deviceHandler(unsigned int interruptLine)
 {
-    unsigned int devNo, mask, status;
-    pcb_PTR outPcb;
+    unsigned int mask = getDeviceBitmap(interruptLine); /* one bit per device with an interrupt pending */
 
-    /* according to specs, use a switch and DEVxON costant to determine device number */
-    mask = getDeviceBitmap(interruptLine);
-    devNo = getDeviceNo(mask); /* get the device number using bitmap*/
-
-    if (interruptLine == IL_TERMINAL)
-    { /* In this case, the device is terminal transm or recv, so
-      we must distinguish between the two subdevices.*/
-        termreg_t *termReg = (termreg_t *)DEV_REG_ADDR(interruptLine, devNo);
-        /* According to pops section 5.7 p.42, status code 5 for both recv_status and trasm_status
-        imply a successful operation on the device. We need to check the last byte*/
-        if ((unsigned char)termReg->recv_status == CHARRECV)
-        { /* in this case, the device is in recv */
-            outPcb = unlockPcbDevNo(devNo, &blockedTerminalRecvQueue);
-            status = termReg->recv_status;
-            termReg->recv_command = ACK;
+    for (unsigned int devNo = 0; devNo < N_DEV_PER_IL; devNo++)
+    {
+        if (!(mask & (DEV0ON << devNo)))
+            continue;
+        if (interruptLine == IL_TERMINAL)
+        { /* In this case, the device is terminal transm or recv, so
+          we must distinguish between the two subdevices, both may be pending.*/
+            termreg_t *termReg = (termreg_t *)DEV_REG_ADDR(interruptLine, devNo);
+            if (termDone(termReg->transm_status))
+            {
+                unsigned int status = termReg->transm_status;
+                termReg->transm_command = ACK;
+                completeIo(interruptLine, devNo, SUBDEVTRANSM, status);
+            }
+            if (termDone(termReg->recv_status))
+            {
+                unsigned int status = termReg->recv_status;
+                termReg->recv_command = ACK;
+                if (termInArmed(devNo)) /* the character goes to the receive ring */
+                    termInChar(devNo, status);
+                else
+                    completeIo(interruptLine, devNo, SUBDEVRECV, status);
+            }
         }
-        else if ((unsigned char)termReg->transm_status == OKCHARTRANS)
-        { /* unsigned char allow us to retrieve the last byte of the status, transm case*/
-            outPcb = unlockPcbDevNo(devNo, &blockedTerminalTransmQueue);
-            status = termReg->transm_status;
-            termReg->transm_command = ACK;
+        else
+        { /* In this case, the device is not terminal, neither transm or recv, so
+            it could be disk, flash, ethernet or printer.*/
+            dtpreg_t *not_termReg = (dtpreg_t *)DEV_REG_ADDR(interruptLine, devNo);
+            unsigned int status = not_termReg->status;
+            not_termReg->command = ACK;
+            /* the requester gets the status, and the device goes on with its next request */
+            completeIo(interruptLine, devNo, SUBDEVTRANSM, status);
         }
     }
-    else
-    { /* In this case, the device is not terminal, neither transm or recv, so
-        it could be disk, flash, ethernet or printer.*/
-        dtpreg_t *not_termReg = (dtpreg_t *)DEV_REG_ADDR(interruptLine, devNo);
-        outPcb = getPcbFromLine(interruptLine, devNo);
-        status = not_termReg->status;
-        not_termReg->command = ACK;
-    }
-
-    if (outPcb != NULL)
-    { /* without passing by the ssi, we put the status in the inbox 
-        to unlock the i/o process. */
-        msg_PTR msg = allocMsg();
-        msg->m_sender = ssi_pcb;
-        msg->m_payload = outPcb->p_s.reg_v0 = status;
-        insertMessage(&outPcb->msg_inbox, msg);
-        insertProcQ(&readyQueue, outPcb);
-        softBlockCount--;
-    }
-    exitInterruptHandler();
 }
 
 /**
- * @brief Handles the various interrupts in order of priority 1 to 7.
+ * @brief Handles every pending interrupt in a single exception entry: the interval timer and all the
+ *        devices of all the asserted lines, in order of priority, are served and acknowledged, waking
+ *        all their waiters. Then the processor is rescheduled once: by the PLT handler if the time slice
+ *        is over, otherwise the interrupted process goes on.
  *
  * @return void
  */
@@ -194,18 +202,19 @@ void interruptHandler()
     for uniprocessor environments more info on chapter 5 pops. */
     unsigned int bitmask = EXCEPTION_STATE->cause & CAUSE_IP_MASK;
     setSTATUS(getSTATUS() & ~TEBITON); /* we disable PLT since it should not proceed in interrupt handling*/
-    if (LOCALTIMERINT & bitmask)
-        PLTHandler();
-    else if (TIMERINTERRUPT & bitmask)
+    if (TIMERINTERRUPT & bitmask)
         intervalTimerHandler();
-    else if (DISKINTERRUPT & bitmask) /* from here, interrupt devices*/
+    if (DISKINTERRUPT & bitmask) /* from here, interrupt devices*/
         deviceHandler(IL_DISK);
-    else if (FLASHINTERRUPT & bitmask)
+    if (FLASHINTERRUPT & bitmask)
         deviceHandler(IL_FLASH);
-    else if (NETWORKINTERRUPT & bitmask)
+    if (NETWORKINTERRUPT & bitmask)
         deviceHandler(IL_ETHERNET);
-    else if (PRINTINTERRUPT & bitmask)
+    if (PRINTINTERRUPT & bitmask)
         deviceHandler(IL_PRINTER);
-    else if (TERMINTERRUPT & bitmask)
+    if (TERMINTERRUPT & bitmask)
         deviceHandler(IL_TERMINAL);
-}
\ No newline at end of file
+    if ((LOCALTIMERINT & bitmask) && current_process != NULL)
+        PLTHandler();
+    exitInterruptHandler();
+}
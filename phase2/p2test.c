@@ -24,8 +24,10 @@ typedef unsigned int devregtr;
 /* hardware constants */
 #define PRINTCHR 2
 #define RECVD 5
+#define PRINTREADY 1
 
 #define CLOCKINTERVAL 100000UL /* interval to V clock semaphore */
+#define ASYNCSLEEP 100000        /* microseconds p3 sleeps while its asynchronous i/o completes */
 
 #define TERMSTATMASK 0xFF
 #define CAUSEMASK 0xFF
@@ -551,6 +553,37 @@ void p3()
     if (pid != p3pid)
         print_term0("Inconsistent process id for p3!\n");
 
+    /* an asynchronous i/o that completes while p3 sleeps: the completion must not wake the sleep */
+    devregtr *printer = (devregtr *)PRINT0ADDR;
+    unsigned int io_id, io_status, from;
+    ssi_do_io_t do_io_async = {
+        .commandAddr = printer + 1,
+        .commandValue = PRINTCHR,
+    };
+    ssi_payload_t do_io_async_payload = {
+        .service_code = DOIOASYNC,
+        .arg = &do_io_async,
+    };
+    ssi_payload_t sleep_payload = {
+        .service_code = SLEEPFOR,
+        .arg = (void *)ASYNCSLEEP,
+    };
+    printer[2] = 'p'; /* DATA0 */
+    SYSCALL(SENDMESSAGE, (unsigned int)ssi_pcb, (unsigned int)(&do_io_async_payload), 0);
+    SYSCALL(RECEIVEMESSAGE, (unsigned int)ssi_pcb, (unsigned int)(&io_id), 0);
+    STCK(time1);
+    SYSCALL(SENDMESSAGE, (unsigned int)ssi_pcb, (unsigned int)(&sleep_payload), 0);
+    SYSCALL(RECEIVEMESSAGE, (unsigned int)ssi_pcb, 0, 0);
+    STCK(time2);
+    from = SYSCALL(RECEIVEMESSAGE, IOCOMPLETION, (unsigned int)(&io_status), 0);
+
+    if ((int)io_id == MSGNOGOOD || from != IOCOMPLETION || io_status != PRINTREADY)
+        print_term0("ERROR: p3 - DOIOASYNC completion not delivered\n");
+    else if (time2 - time1 < ASYNCSLEEP * (*((cpu_t *)TIMESCALEADDR)))
+        print_term0("ERROR: p3 - DOIOASYNC completion taken as the SLEEPFOR reply\n");
+    else
+        print_term0("p3 - DOIOASYNC OK\n");
+
     // notify p1 that p3 ended
     SYSCALL(SENDMESSAGE, (unsigned int)test_pcb, 0, 0);
 
@@ -1,15 +1,140 @@
 #include "./headers/lib.h"
 
+/* index of the highest set bit of a nibble, the bitmap is scanned a nibble at a time */
+static const unsigned char highestBit[16] = {0, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3};
+
+/**
+ * @brief Inserts p at the tail of the ready queue of its priority, marking it in the bitmap.
+ *
+ * @param p the pcb
+ * @return void
+ */
+void insertReadyQ(pcb_PTR p)
+{
+    insertProcQ(&readyQueue[p->p_prio], p);
+    readyBitmap |= 1 << p->p_prio;
+}
+
+/**
+ * @brief Removes the first pcb of the highest priority non-empty ready queue, in constant time.
+ *
+ * @param void
+ * @return pcb_PTR - the pcb, NULL if no process is ready
+ */
+pcb_PTR removeReadyQ()
+{
+    if (readyBitmap == 0)
+        return NULL;
+    unsigned int prio = (readyBitmap >> 4) ? highestBit[readyBitmap >> 4] + 4 : highestBit[readyBitmap];
+    pcb_PTR p = removeProcQ(&readyQueue[prio]);
+    if (emptyProcQ(&readyQueue[prio]))
+        readyBitmap &= ~(1 << prio);
+    return p;
+}
+
+/**
+ * @brief Removes p from the ready queue of its priority, if it is there.
+ *
+ * @param p the pcb
+ * @return pcb_PTR - p, NULL if it was not ready
+ */
+pcb_PTR outReadyQ(pcb_PTR p)
+{
+    pcb_PTR out = outProcQ(&readyQueue[p->p_prio], p);
+    if (out != NULL && emptyProcQ(&readyQueue[p->p_prio]))
+        readyBitmap &= ~(1 << p->p_prio);
+    return out;
+}
+
+/**
+ * @brief Tells if p is scheduled by the multi-level feedback queue, servers and drivers keep their priority.
+ *
+ * @param p the pcb
+ * @return int - 1 if the priority of p is managed by the MLFQ
+ */
+static int isFeedbackPcb(pcb_PTR p)
+{
+    return (MLFQ && p->p_prio < MLFQLEVELS);
+}
+
+/**
+ * @brief A new process of the feedback levels starts from the top one.
+ *
+ * @param p the pcb, not in a ready queue yet
+ * @return void
+ */
+void mlfqAdmit(pcb_PTR p)
+{
+    if (isFeedbackPcb(p))
+        p->p_prio = MLFQTOP;
+}
+
+/**
+ * @brief The process used up its time slice, so it is CPU-bound: one level down.
+ *
+ * @param p the pcb, not in a ready queue
+ * @return void
+ */
+void mlfqExpire(pcb_PTR p)
+{
+    if (isFeedbackPcb(p) && p->p_prio > 0)
+        p->p_prio--;
+}
+
+/**
+ * @brief The process is blocking: if its cpu burst, taken from the p_time accounting of
+ *        updatePCBTime, was shorter than a time slice it is I/O-bound, so one level up.
+ *
+ * @param p the pcb, with its time already updated
+ * @return void
+ */
+void mlfqBlock(pcb_PTR p)
+{
+    if (isFeedbackPcb(p) && p->p_burst < TODTICKS(TIMESLICE) && p->p_prio < MLFQTOP)
+        p->p_prio++;
+    p->p_burst = 0;
+}
+
+/**
+ * @brief Moves every ready process of the lower feedback levels to the top one,
+ *        so that CPU-bound processes cannot starve.
+ *
+ * @param void
+ * @return void
+ */
+void mlfqBoost()
+{
+    pcb_PTR p;
+    for (int prio = 0; prio < MLFQTOP; prio++)
+    {
+        while ((p = removeProcQ(&readyQueue[prio])) != NULL)
+        {
+            p->p_prio = MLFQTOP;
+            insertReadyQ(p);
+        }
+        readyBitmap &= ~(1 << prio);
+    }
+}
+
 /**
  * @brief The nuceleus scheduler. The implementation is pre-emptive round robin algorithm with
- *        a time slice of 5ms. Its main goal is to dispatch the next process in the readyQueue.
+ *        a time slice of 5ms within each priority: the next process is taken from the highest
+ *        priority non-empty readyQueue. Every MLFQBOOST seconds the feedback levels are boosted first.
  *
  * @param void
  * @return void
  */
 void scheduler()
 {
-    current_process = removeProcQ(&readyQueue);
+    static unsigned int lastBoost = 0;
+    unsigned int now = getTOD();
+    if (MLFQ && now - lastBoost >= TODTICKS(MLFQBOOST * PSECOND))
+    { /* checked on every dispatch: the lower levels starve even when the upper ones
+      always block before their slice ends, so that no PLT interrupt ever comes */
+        lastBoost = now;
+        mlfqBoost();
+    }
+    current_process = removeReadyQ();
     if (current_process == NULL)
     { /* Empty Ready Queue case
      Check with process counters if any kind of deadlock situation is happening */
@@ -33,3 +158,17 @@ void scheduler()
         LDST(&(current_process->p_s));
     }
 }
+
+/**
+ * @brief Dispatches p right away, without passing through the readyQueue. Used for the direct
+ *        handoff of CALLMESSAGE/REPLYRECVMESSAGE: the PLT is not reloaded, so p goes on with the
+ *        time slice donated by the process that handed the CPU over.
+ *
+ * @param p the pcb to dispatch, blocked waiting for a message
+ * @return void
+ */
+void switchTo(pcb_PTR p)
+{
+    current_process = p;
+    LDST(&(p->p_s));
+}
@@ -0,0 +1,143 @@
+#include "./headers/lib.h"
+
+/* min-heap of the sleeping pcbs, ordered by wake-up TOD; each pcb keeps its position in p_sleepIdx */
+static pcb_PTR sleepHeap[MAXPCBINDEX];
+static int sleepCount = 0;
+
+/**
+ * @brief Tells if TOD a comes before TOD b, also across the wrap around of the clock.
+ *
+ * @param a the first TOD
+ * @param b the second TOD
+ * @return int - 1 if a is earlier than b
+ */
+static int todBefore(unsigned int a, unsigned int b)
+{
+    return ((int)(a - b) < 0);
+}
+
+/**
+ * @brief Puts p in position i of the heap, keeping its back index.
+ *
+ * @param i the position
+ * @param p the pcb
+ * @return void
+ */
+static void heapSet(int i, pcb_PTR p)
+{
+    sleepHeap[i] = p;
+    p->p_sleepIdx = i;
+}
+
+/**
+ * @brief Moves the pcb in position i up, while it wakes before its parent.
+ *
+ * @param i the position
+ * @return void
+ */
+static void heapUp(int i)
+{
+    pcb_PTR p = sleepHeap[i];
+    while (i > 0 && todBefore(p->p_wakeTOD, sleepHeap[(i - 1) / 2]->p_wakeTOD))
+    {
+        heapSet(i, sleepHeap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    heapSet(i, p);
+}
+
+/**
+ * @brief Moves the pcb in position i down, while one of its children wakes before it.
+ *
+ * @param i the position
+ * @return void
+ */
+static void heapDown(int i)
+{
+    pcb_PTR p = sleepHeap[i];
+    while (2 * i + 1 < sleepCount)
+    {
+        int child = 2 * i + 1;
+        if (child + 1 < sleepCount && todBefore(sleepHeap[child + 1]->p_wakeTOD, sleepHeap[child]->p_wakeTOD))
+            child++;
+        if (!todBefore(sleepHeap[child]->p_wakeTOD, p->p_wakeTOD))
+            break;
+        heapSet(i, sleepHeap[child]);
+        i = child;
+    }
+    heapSet(i, p);
+}
+
+/**
+ * @brief Suspends sender until the TOD clock reaches wakeTOD (SLEEPFOR/SLEEPUNTIL services).
+ *        The sender waits for the reply of the ssi, that is notified by the interval timer
+ *        interrupt in the same way as a pseudo-clock tick.
+ *
+ * @param sender the process that requested the service
+ * @param wakeTOD the TOD at which the sender has to be awakened
+ * @return int - 1 if the sender sleeps, 0 if wakeTOD is already past and it must be answered now
+ */
+int sleepUntil(pcb_PTR sender, unsigned int wakeTOD)
+{
+    if (!todBefore(getTOD(), wakeTOD))
+        return 0;
+    sender->p_wakeTOD = wakeTOD;
+    sleepHeap[sleepCount] = sender;
+    heapUp(sleepCount++);
+    softBlockCount++;
+    armIntervalTimer();
+    return 1;
+}
+
+/**
+ * @brief Removes p from the sleeping pcbs, if it sleeps (e.g. because it is being terminated).
+ *
+ * @param p the pcb
+ * @return int - 1 if p was sleeping, 0 otherwise
+ */
+int sleepCancel(pcb_PTR p)
+{
+    int i = p->p_sleepIdx;
+    if (i < 0)
+        return 0;
+    p->p_sleepIdx = -1;
+    if (i != --sleepCount)
+    { /* the last pcb of the heap fills the hole, then it is moved where it belongs */
+        pcb_PTR last = sleepHeap[sleepCount];
+        heapSet(i, last);
+        heapUp(i);
+        heapDown(last->p_sleepIdx);
+    }
+    return 1;
+}
+
+/**
+ * @brief Wakes up every sleeping pcb whose wake-up TOD is not after now, in deadline order.
+ *
+ * @param now the current TOD
+ * @return void
+ */
+void wakeSleepers(unsigned int now)
+{
+    while (sleepCount > 0 && !todBefore(now, sleepHeap[0]->p_wakeTOD))
+    {
+        pcb_PTR p = sleepHeap[0];
+        sleepCancel(p);
+        notify(p, NOTIFYCLOCK, 0);
+        softBlockCount--;
+    }
+}
+
+/**
+ * @brief Gives the earliest wake-up TOD among the sleeping pcbs.
+ *
+ * @param tod where the TOD is stored
+ * @return int - 1 if some pcb sleeps, 0 otherwise
+ */
+int nextSleepTOD(unsigned int *tod)
+{
+    if (sleepCount == 0)
+        return 0;
+    *tod = sleepHeap[0]->p_wakeTOD;
+    return 1;
+}
@@ -6,59 +6,42 @@
  *
  * @param sup the support structure of the new process
  * @param parent the parent process
- * @return int the address of the new process
+ * @return int the address of the new process, NOPROC if there is no free pcb or the priority is not in [0, NPRIO)
  */
 unsigned int createProcess(pcb_PTR parent, ssi_create_process_PTR sup)
 {
-	if (emptyProcQ(&pcbFree_h))
+	if (sup->priority >= NPRIO) /* never guess a level, it could be the one of the servers */
 		return NOPROC;
 	pcb_PTR child = allocPcb();
 	if (child == NULL)
 		return NOPROC;
 
 	child->p_supportStruct = sup->support;
+	child->p_prio = sup->priority;
+	mlfqAdmit(child);
 
 	/* copy the state sent along with the request in the
 		new child pcb and insert the newborn the readyQueue*/
 	stateCpy(sup->state, &child->p_s);
-	insertProcQ(&readyQueue, child);
+	insertReadyQ(child);
 	insertChild(parent, child);
 	processCount++;
 	return (unsigned int)child;
 }
 
 /**
- * @brief Check if the PCB is blocked on a device, looking at all device queues.
+ * @brief Check if the PCB is blocked on a device (or on the pseudo-clock). If so, the PCB is removed from
+ * 		  the pseudo-clock queue, or its synchronous DoIO request is withdrawn.
  *
  * @param sender the pcb that should be checked
- * @return 1 if the PCB is blocked on a device, 0 otherwise
+ * @return 1 if the PCB was counted as soft blocked and no longer is, 0 otherwise
  */
 unsigned int isPcbBlockedOnDevice(pcb_PTR sender)
 {
-	if (sender->blockedOnDevice != -1){ /* pcb is blocked on some device */
-	switch (sender->blockedOnDevice){
-		case IL_TERMINAL:
-			return (outProcQ(&blockedTerminalRecvQueue, sender) != NULL 
-				|| outProcQ(&blockedTerminalTransmQueue, sender) != NULL
-				|| outProcQ(&pseudoClockQueue, sender) != NULL);
-		case IL_DISK:
-			return (outProcQ(&blockedDiskQueue, sender) != NULL 
-			|| outProcQ(&pseudoClockQueue, sender) != NULL);
-		case IL_FLASH:
-			return (outProcQ(&blockedFlashQueue, sender) != NULL 
-			|| outProcQ(&pseudoClockQueue, sender) != NULL);
-		case IL_ETHERNET:
-			return (outProcQ(&blockedEthernetQueue, sender) != NULL 
-			|| outProcQ(&pseudoClockQueue, sender) != NULL);
-		case IL_PRINTER:
-			return (outProcQ(&blockedPrinterQueue, sender) != NULL 
-			|| outProcQ(&pseudoClockQueue, sender) != NULL);
-		default:
-			return (outProcQ(&pseudoClockQueue, sender) != NULL);
-		}
-	}
-	else 
-		return 0;
+	if (sender->p_queue == &pseudoClockQueue)
+		return (outProcQ(&pseudoClockQueue, sender) != NULL);
+	else
+		return (ioCancel(sender) || termInCancel(sender));
 }
 
 /**
@@ -80,96 +63,385 @@ void terminateProcess(pcb_PTR sender)
 	while (!emptyChild(sender))
 		terminateProcess(removeChild(sender));
 
-	if (isPcbBlockedOnDevice(sender))
+	if (isPcbBlockedOnDevice(sender) || sleepCancel(sender))
 		softBlockCount--;
+	else /* a ready pcb leaves its queue here, so the ready bitmap stays exact */
+		outReadyQ(sender);
+
+	/* messages left in the inbox will never be received */
+	msg_PTR msg;
+	while ((msg = popInboxMessage(sender, ANYMESSAGE)) != NULL)
+		freeMsg(msg);
 
 	outChild(sender);
 	freePcb(sender);
 	processCount--;
 }
 
+/* table of the DoIO requests and list of the free ones */
+static iorequest_t ioReqTable[MAXIOREQ];
+static struct list_head ioReqFree_h;
+/* id of the next asynchronous request, never 0 */
+static unsigned int ioNextId = 1;
+
 /**
- * @brief Insert the process in the curresponding device queue.
+ * @brief Initializes the free list of the DoIO requests.
  *
- * @param interruptLine the interrupt line of the device
- * @param sender the process that requested the service
+ * @param void
+ * @return void
+ */
+void initIoRequests()
+{
+	INIT_LIST_HEAD(&ioReqFree_h);
+	for (int i = 0; i < MAXIOREQ; i++)
+		list_add_tail(&ioReqTable[i].ir_list, &ioReqFree_h);
+}
+
+/**
+ * @brief Tells if r is the request its device is serving, that is the head of the device FIFO.
+ *
+ * @param r the request, queued
+ * @return int - 1 if the command of r has been written to the device
+ */
+static int ioInFlight(iorequest_PTR r)
+{
+	return (r->ir_queue->next == &r->ir_list);
+}
+
+/**
+ * @brief Writes the command of r to its device. For a string request the command writes the
+ *        next character: printers take it in DATA0, terminals in the command itself.
+ *        The DMA address of a disk or flash command is written in DATA0 only now, when the
+ *        device is idle, so that requests queued on the same device do not overwrite it.
+ *
+ * @param r the request, at the head of its device FIFO
  * @return void
  */
-void insertDeviceQ(unsigned int interruptLine, pcb_PTR sender)
+static void ioIssue(iorequest_PTR r)
 {
-	switch (interruptLine)
+	if (r->ir_buf == NULL)
 	{
-	case IL_DISK:
-		insertProcQ(&blockedDiskQueue, sender);
-		break;
-	case IL_FLASH:
-		insertProcQ(&blockedFlashQueue, sender);
-		break;
-	case IL_ETHERNET:
-		insertProcQ(&blockedEthernetQueue, sender);
-		break;
-	case IL_PRINTER:
-		insertProcQ(&blockedPrinterQueue, sender);
-		break;
+		if (r->ir_data0 != 0 && (r->ir_line == IL_DISK || r->ir_line == IL_FLASH))
+			*(r->ir_cmd + 1) = r->ir_data0; /* DATA0 follows COMMAND */
+		*(r->ir_cmd) = r->ir_value;
+	}
+	else if (r->ir_line == IL_PRINTER)
+	{
+		*(r->ir_cmd + 1) = (unsigned char)r->ir_buf[r->ir_done]; /* DATA0 follows COMMAND */
+		*(r->ir_cmd) = PRINTCHR;
 	}
+	else
+		*(r->ir_cmd) = TRANSMITCHAR | ((unsigned char)r->ir_buf[r->ir_done] << BYTELENGTH);
 }
 
+/**
+ * @brief Tells if the device completed the last command of a string request successfully.
+ *
+ * @param r the request
+ * @param status the status of the device
+ * @return int - 1 on success
+ */
+static int ioCharDone(iorequest_PTR r, unsigned int status)
+{
+	if (r->ir_line == IL_PRINTER)
+		return (status == DEVREADY);
+	return ((status & TERMSTATMASK) == OKCHARTRANS);
+}
 
 /**
- * @brief Handles the synchronous I/O requests.
+ * @brief Queues a request on the FIFO of its (sub)device. The command is written right away only if the
+ *        device is idle, otherwise it is written when the previous request completes, so that a command
+ *        never overwrites another one. Every pending request counts as a soft blocked process.
  *
- * @param doioPTR the IO request, as a pointer to the doio struct
- * @param sender the process that requested the service
+ * @param d the descriptor of the device
+ * @param r the request, filled in
  * @return void
  */
-void doio(ssi_do_io_PTR doioPTR, pcb_PTR sender)
+static void ioQueue(devdesc_PTR d, iorequest_PTR r)
 {
+	r->ir_queue = d->dd_queue;
+	r->ir_line = d->dd_line;
+	list_add_tail(&r->ir_list, d->dd_queue);
 	softBlockCount++;
-	unsigned int deviceCommand = (unsigned int)doioPTR->commandAddr;
-	/* We need to distinguish between terminal and not-terminal devices, that are transm and recv
-	so, according to uMPS3 - Principles of Operation, each device is identified by the interrupt line
-	it is attached to and its device number, an integer in the range 0-7. Important! in order of priority */
-
-	/* If the device isn't a terminal device, then it is a disk, flash, ethernet or printer device
-	   so, we iter on those basing on their identifiers.
-	   According to uMPS3 - Principles of Operation p.29 devices have interrupts pending on interrupt lines 3-7.
-	   That means that when bit i in word j is set to one, then device i attached to interrupt line j + 3 has a pending interrupt. */
-	for (unsigned int interruptLine = DEV_IL_START; interruptLine < N_INTERRUPT_LINES; interruptLine++)
+	if (ioInFlight(r))
+		ioIssue(r);
+}
+
+/**
+ * @brief Withdraws the synchronous request p waits for, because p is being terminated. A request still
+ *        queued is dropped; the one the device is serving is left to complete, without a requester.
+ *        A string in flight stops after the current character, since the buffer belongs to p.
+ *
+ * @param p the pcb
+ * @return int - 1 if a queued request was dropped (one soft blocked less), 0 otherwise
+ */
+int ioCancel(pcb_PTR p)
+{
+	iorequest_PTR r = p->p_ioReq;
+	if (r == NULL)
+		return 0;
+	p->p_ioReq = NULL;
+	if (ioInFlight(r))
 	{
-		for (unsigned int devNo = 0; devNo < N_DEV_PER_IL; devNo++)
+		r->ir_pid = 0;
+		r->ir_buf = NULL; /* completeIo does not go on with a string */
+		return 0;
+	}
+	list_del(&r->ir_list);
+	list_add(&r->ir_list, &ioReqFree_h);
+	return 1;
+}
+
+/**
+ * @brief Completes the request a (sub)device was serving, with the status read from the device, and
+ *        writes the command of the next queued request, if any. A synchronous requester gets the status
+ *        through its notification word, an asynchronous one in the message allocated with the request.
+ *
+ * @param line the interrupt line of the device
+ * @param devNo the device number
+ * @param sub the subdevice
+ * @param status the status of the device
+ * @return void
+ */
+void completeIo(unsigned int line, unsigned int devNo, unsigned int sub, unsigned int status)
+{
+	struct list_head *q = DEVQUEUE(line, devNo, sub);
+	if (list_empty(q))
+		return;
+	iorequest_PTR r = container_of(q->next, iorequest_t, ir_list);
+	if (r->ir_buf != NULL && ioCharDone(r, status) && ++r->ir_done < r->ir_len)
+	{ /* the string goes on straight from here, without waking anybody */
+		ioIssue(r);
+		return;
+	}
+	pcb_PTR p = (r->ir_pid != 0) ? resolvePcb(r->ir_pid) : NULL;
+	list_del(&r->ir_list);
+	softBlockCount--;
+
+	if (r->ir_id == 0)
+	{ /* without passing by the ssi, we put the status in the notification word to unlock the i/o process */
+		if (p != NULL)
 		{
-			if (interruptLine == IL_TERMINAL)
-			{ /* calculate the address for this device's terminal device register */
-				termreg_t *devAddrBase = (termreg_t *)DEV_REG_ADDR(IL_TERMINAL, devNo);
-				if ((unsigned int)&devAddrBase->transm_command == deviceCommand)
-				{
-					sender->blockedOnDevice = devNo;
-					outProcQ(&readyQueue, sender);
-					insertProcQ(&blockedTerminalTransmQueue, sender);
-					break;
-				}
-				else if ((unsigned int)&devAddrBase->recv_command == deviceCommand)
-				{
-					sender->blockedOnDevice = devNo;
-					outProcQ(&readyQueue, sender);
-					insertProcQ(&blockedTerminalRecvQueue, sender);
-					break;
-				}
+			p->p_ioReq = NULL;
+			notify(p, NOTIFYDEVICE, status);
+		}
+	}
+	else
+	{
+		r->ir_msg->m_words[0] = status;
+		r->ir_msg->m_words[1] = r->ir_id;
+		if (p != NULL)
+			deliverMsg(r->ir_msg, p);
+		else
+			freeMsg(r->ir_msg);
+	}
+	list_add(&r->ir_list, &ioReqFree_h);
+
+	if (!list_empty(q))
+	{ /* the device is free again, it serves the next request */
+		ioIssue(container_of(q->next, iorequest_t, ir_list));
+	}
+}
+
+
+/* descriptor of every word of the device register area, by word offset from DEV_REG_START */
+static devdesc_t devDescs[NDEVWORDS];
+
+/**
+ * @brief Fills in the descriptor of a command register.
+ *
+ * @param cmd the address of the command register
+ * @param line the interrupt line of the device
+ * @param dev the device number
+ * @param sub the subdevice
+ * @return void
+ */
+static void setDevDesc(memaddr cmd, unsigned int line, unsigned int dev, unsigned int sub)
+{
+	devdesc_PTR d = &devDescs[(cmd - DEV_REG_START) / WORDLEN];
+	d->dd_valid = 1;
+	d->dd_line = line;
+	d->dd_dev = dev;
+	d->dd_sub = sub;
+	d->dd_queue = DEVQUEUE(line, dev, sub);
+}
+
+/**
+ * @brief Builds at boot the table that maps the address of a command register to its device.
+ *        Terminals have two command registers, recv_command and transm_command, the other devices
+ *        (disk, flash, ethernet, printer) only command. Every other word is left invalid.
+ *
+ * @param void
+ * @return void
+ */
+void initDevDescs()
+{
+	for (int i = 0; i < NDEVWORDS; i++)
+		devDescs[i].dd_valid = 0;
+	for (unsigned int line = DEV_IL_START; line < N_INTERRUPT_LINES; line++)
+	{
+		for (unsigned int dev = 0; dev < N_DEV_PER_IL; dev++)
+		{
+			if (line == IL_TERMINAL)
+			{
+				termreg_t *term = (termreg_t *)DEV_REG_ADDR(line, dev);
+				setDevDesc((memaddr)&term->recv_command, line, dev, SUBDEVRECV);
+				setDevDesc((memaddr)&term->transm_command, line, dev, SUBDEVTRANSM);
 			}
 			else
-			{ /* calculate base address for non-terminal devices */
-				dtpreg_t *devAddrBase = (dtpreg_t *)DEV_REG_ADDR(interruptLine, devNo);
-				if ((unsigned int)&devAddrBase->command == deviceCommand)
-				{
-					sender->blockedOnDevice = devNo;
-					outProcQ(&readyQueue, sender);
-					insertDeviceQ(interruptLine, sender);
-					break;
-				}
+			{
+				dtpreg_t *dtp = (dtpreg_t *)DEV_REG_ADDR(line, dev);
+				setDevDesc((memaddr)&dtp->command, line, dev, SUBDEVTRANSM);
 			}
 		}
 	}
-	*(doioPTR->commandAddr) = doioPTR->commandValue;
+}
+
+/**
+ * @brief Finds in constant time the device of a command register, through the descriptor table.
+ *
+ * @param deviceCommand the address of the command register
+ * @return devdesc_PTR - the descriptor, NULL if the address is not a command register
+ */
+static devdesc_PTR findDevDesc(memaddr deviceCommand)
+{
+	if (deviceCommand < DEV_REG_START || deviceCommand >= DEV_REG_START + NDEVWORDS * WORDLEN
+		|| (deviceCommand - DEV_REG_START) % WORDLEN != 0)
+		return NULL;
+	devdesc_PTR d = &devDescs[(deviceCommand - DEV_REG_START) / WORDLEN];
+	return d->dd_valid ? d : NULL;
+}
+
+/**
+ * @brief Tells if the (sub)device is used by the nucleus itself, as a terminal receiver fed to its ring.
+ *
+ * @param d the descriptor of the device
+ * @return int - 1 if DoIO requests may not use the device
+ */
+static int ioOwned(devdesc_PTR d)
+{
+	return (d->dd_line == IL_TERMINAL && d->dd_sub == SUBDEVRECV && termInArmed(d->dd_dev));
+}
+
+/**
+ * @brief Takes a free DoIO request and fills it in.
+ *
+ * @param doioPTR the IO request, as a pointer to the doio struct
+ * @param sender the process that requested the service
+ * @return iorequest_PTR - the request, NULL if there is no free one
+ */
+static iorequest_PTR allocIoRequest(ssi_do_io_PTR doioPTR, pcb_PTR sender)
+{
+	if (list_empty(&ioReqFree_h))
+		return NULL;
+	iorequest_PTR r = container_of(ioReqFree_h.next, iorequest_t, ir_list);
+	list_del(&r->ir_list);
+	r->ir_pid = sender->p_pid;
+	r->ir_cmd = doioPTR->commandAddr;
+	r->ir_value = doioPTR->commandValue;
+	r->ir_data0 = doioPTR->data0;
+	r->ir_id = 0;
+	r->ir_msg = NULL;
+	r->ir_buf = NULL;
+	r->ir_len = r->ir_done = 0;
+	return r;
+}
+
+/**
+ * @brief Handles the synchronous I/O requests. The device is found in constant time from the
+ *        address of its command register through the descriptor table, and the request is served
+ *        after the ones already queued on the same device.
+ *
+ * @param doioPTR the IO request, as a pointer to the doio struct
+ * @param sender the process that requested the service
+ * @return int - 1 if the sender waits for the device, 0 if the address is not a command register
+ *         or there are too many pending requests
+ */
+int doio(ssi_do_io_PTR doioPTR, pcb_PTR sender)
+{
+	devdesc_PTR d = findDevDesc((memaddr)doioPTR->commandAddr);
+	iorequest_PTR r;
+	if (d == NULL || ioOwned(d) || (r = allocIoRequest(doioPTR, sender)) == NULL)
+		return 0;
+	sender->p_ioReq = r;
+	ioQueue(d, r);
+	return 1;
+}
+
+/**
+ * @brief Handles the string output requests (DOIOSTRING): the sender waits as for a synchronous doio,
+ *        while the interrupt handler writes the characters one by one, and it is woken once, with the
+ *        status of the last character written (the first that failed, if any).
+ *        The buffer is read from the interrupt handler, so it must not be in a mapped (kuseg) address.
+ *
+ * @param doioPTR the string request
+ * @param sender the process that requested the service
+ * @return int - 1 if the sender waits for the device, 0 if the address is not a printer command or a
+ *         terminal transm_command, the string is empty, or there are too many pending requests
+ */
+int doioString(ssi_do_io_string_PTR doioPTR, pcb_PTR sender)
+{
+	devdesc_PTR d = findDevDesc((memaddr)doioPTR->commandAddr);
+	ssi_do_io_t cmd = {.commandAddr = doioPTR->commandAddr, .commandValue = 0};
+	iorequest_PTR r;
+	if (d == NULL || d->dd_sub != SUBDEVTRANSM || (d->dd_line != IL_PRINTER && d->dd_line != IL_TERMINAL)
+		|| doioPTR->length == 0 || doioPTR->buffer == NULL || (r = allocIoRequest(&cmd, sender)) == NULL)
+		return 0;
+	r->ir_buf = doioPTR->buffer;
+	r->ir_len = doioPTR->length;
+	sender->p_ioReq = r;
+	ioQueue(d, r);
+	return 1;
+}
+
+/**
+ * @brief Handles the line input requests (READLINE): the command address is the recv_command of the
+ *        terminal, the line is buffered by the nucleus (see termin.c).
+ *
+ * @param doioPTR the request, with the recv_command address, the buffer and its size
+ * @param sender the process that requested the service
+ * @param count where the number of characters read is stored, if the sender is answered now
+ * @return int - 1 if the sender waits for the line, 0 if it is answered now, -1 if the address
+ *         is not a terminal recv_command or the terminal cannot be read now
+ */
+int readLine(ssi_do_io_string_PTR doioPTR, pcb_PTR sender, unsigned int *count)
+{
+	devdesc_PTR d = findDevDesc((memaddr)doioPTR->commandAddr);
+	if (d == NULL || d->dd_line != IL_TERMINAL || d->dd_sub != SUBDEVRECV
+		|| doioPTR->length == 0 || doioPTR->buffer == NULL)
+		return -1;
+	return termInRead(d->dd_dev, sender, doioPTR->buffer, doioPTR->length, count);
+}
+
+/**
+ * @brief Handles the asynchronous I/O requests (DOIOASYNC): the request is queued on its device as in doio,
+ *        but the sender is answered right away with the request id. When the device completes the request,
+ *        the sender gets a message from the IOCOMPLETION pseudo sender with the status and the request id.
+ *
+ * @param doioPTR the IO request, as a pointer to the doio struct
+ * @param sender the process that requested the service
+ * @return unsigned int - the request id, MSGNOGOOD if the address is not a command register
+ *         or there are too many pending requests
+ */
+unsigned int doioAsync(ssi_do_io_PTR doioPTR, pcb_PTR sender)
+{
+	devdesc_PTR d = findDevDesc((memaddr)doioPTR->commandAddr);
+	iorequest_PTR r;
+	msg_PTR msg;
+	if (d == NULL || ioOwned(d) || (msg = allocMsg()) == NULL)
+		return MSGNOGOOD;
+	if ((r = allocIoRequest(doioPTR, sender)) == NULL)
+	{
+		freeMsg(msg);
+		return MSGNOGOOD;
+	}
+	msg->m_senderPid = IOCOMPLETION; /* not ssi_pcb, or a receive from the ssi could take it */
+	r->ir_msg = msg;
+	r->ir_id = ioNextId++;
+	if (ioNextId == 0)
+		ioNextId = 1;
+	ioQueue(d, r);
+	return r->ir_id;
 }
 
 /**
@@ -210,6 +482,7 @@ void updatePCBTime(pcb_PTR sender)
 {
 	unsigned int endTOD = getTOD();
 	sender->p_time += endTOD - startTOD;
+	sender->p_burst += endTOD - startTOD;
 	startTOD = endTOD;
 }
 
@@ -234,7 +507,10 @@ void setPLT(unsigned int time)
  */
 void wait4Clock(pcb_PTR sender)
 {
+	int first = emptyProcQ(&pseudoClockQueue);
 	insertProcQ(&pseudoClockQueue, sender);
+	if (first) /* the interval timer does not count for the pseudo-clock yet */
+		armPseudoClock();
 	softBlockCount++;
 }
 
@@ -254,6 +530,7 @@ unsigned int getSupportData(pcb_PTR sender)
 /**
  * @brief Allow the sender to get the process ID of the process that requested the service.
  * 		  If arg is 0 return the sender's pid, or otherwise the sender's parent pid.
+ * 		  The pid is the process handle, so it can be used as destination of a SENDMESSAGE.
  * @param sender the process that requested the service
  * @param arg the argument of the message
  * @return unsigned int the process ID
@@ -262,8 +539,10 @@ unsigned int getProcessID(pcb_PTR sender, pcb_PTR arg)
 {
 	if (arg == NULL)
 		return sender->p_pid;
-	else
+	else if (sender->p_parent != NULL)
 		return (sender->p_parent)->p_pid;
+	else
+		return 0;
 }
 
 /**
@@ -284,21 +563,33 @@ unsigned int SSIRequest(pcb_PTR sender, unsigned int service, void *arg)
 		res = createProcess(sender, (ssi_create_process_PTR)arg);
 		break;
 	case TERMPROCESS:
-		if (arg != NULL) /* this case suggest that the process sent as payload should be killed */
-			terminateProcess(arg);
+		if (arg != NULL) /* this case suggest that the process sent as payload (address or pid) should be killed */
+			terminateProcess(resolvePcb((unsigned int)arg));
 		else /* if the argument is NULL, then the process that requested the service must be terminated */
 			terminateProcess(sender);
 		break;
-	case DOIO:
-		doio(arg, sender);
-		res = NOPROC;
+	case DOIO: /* a command address of no device is answered right away */
+		res = doio(arg, sender) ? NOREPLY : MSGNOGOOD;
+		break;
+	case DOIOASYNC:
+		res = doioAsync(arg, sender);
+		break;
+	case DOIOSTRING:
+		res = doioString(arg, sender) ? NOREPLY : MSGNOGOOD;
 		break;
+	case READLINE:
+	{ /* a whole line already typed is answered right away */
+		int wait = readLine(arg, sender, &res);
+		if (wait != 0)
+			res = (wait > 0) ? NOREPLY : MSGNOGOOD;
+		break;
+	}
 	case GETTIME:
 		res = getCPUTime(sender);
 		break;
 	case CLOCKWAIT:
 		wait4Clock(sender);
-		res = NOPROC;
+		res = NOREPLY;
 		break;
 	case GETSUPPORTPTR:
 		res = getSupportData(sender);
@@ -306,6 +597,12 @@ unsigned int SSIRequest(pcb_PTR sender, unsigned int service, void *arg)
 	case GETPROCESSID:
 		res = getProcessID(sender, arg);
 		break;
+	case SLEEPFOR: /* arg is in microseconds; a sleep that is already over is answered right away */
+		res = sleepUntil(sender, getTOD() + TODTICKS((unsigned int)arg)) ? NOREPLY : 0;
+		break;
+	case SLEEPUNTIL: /* arg is a TOD clock value, in ticks */
+		res = sleepUntil(sender, (unsigned int)arg) ? NOREPLY : 0;
+		break;
 	default:
 		terminateProcess(sender);
 		res = MSGNOGOOD;
@@ -314,29 +611,89 @@ unsigned int SSIRequest(pcb_PTR sender, unsigned int service, void *arg)
 	return res;
 }
 
+/**
+ * @brief Handles a SSI request carried inline in the words of a register passed message:
+ * 		  words[0] is the service code and the following words are its arguments, so the
+ * 		  SSI does not need to read the memory of the sender.
+ *
+ * @param sender the process that requested the service
+ * @param words the MSGWORDS words of the message
+ * @return unsigned int the result of the service
+ */
+unsigned int SSIRegRequest(pcb_PTR sender, unsigned int *words)
+{
+	switch (words[0])
+	{
+	case CREATEPROCESS:
+	{
+		ssi_create_process_t create = {
+			.state = (state_t *)words[1],
+			.support = (support_t *)words[2],
+			.priority = words[3],
+		};
+		return SSIRequest(sender, CREATEPROCESS, &create);
+	}
+	case DOIO:
+	case DOIOASYNC:
+	{
+		ssi_do_io_t do_io = {
+			.commandAddr = (memaddr *)words[1],
+			.commandValue = words[2],
+			.data0 = words[3],
+		};
+		return SSIRequest(sender, words[0], &do_io);
+	}
+	case DOIOSTRING:
+	case READLINE:
+	{
+		ssi_do_io_string_t do_io = {
+			.commandAddr = (memaddr *)words[1],
+			.buffer = (char *)words[2],
+			.length = words[3],
+		};
+		return SSIRequest(sender, words[0], &do_io);
+	}
+	default: /* the other services take at most a single word argument */
+		return SSIRequest(sender, words[0], (void *)words[1]);
+	}
+}
+
 /**
  * @brief The SSI service. It is responsible for handling the SSI requests.
  * 		  If everything goes well, the SSI loop will send a message to the process that requested the service.
  * 		  If SSI ever gets terminated, the system must be stopped performing an emergency shutdown.
+ * 		  A request is either a pointer to a ssi_payload_t (SENDMESSAGE) or the service code followed
+ * 		  by its arguments (SENDREGMESSAGE), told apart by the value of the first word.
  *
  * @param void
  * @return void
  */
 void SSI()
 { /* The idea is that this process constantly listens to requests, and then it responds */
+	/* When a process requires a SSI service it must wait for an answer, so we use the blocking synchronous recv */
+	unsigned int words[MSGWORDS];
+	unsigned int *senderAddr = (unsigned int *)recvRegMessage(ANYMESSAGE, words);
 	while (1)
 	{
-		unsigned int *senderAddr, result;
-		pcb_PTR payload;
-
-		SYSCALL(RECEIVEMESSAGE, ANYMESSAGE, (unsigned int)&payload, 0);
-		senderAddr = (unsigned int *)EXCEPTION_STATE->reg_v0;
-		/* When a process requires a SSI service it must wait for an answer, so we use the blocking synchronous recv */
-		ssi_payload_PTR ssipyld = (ssi_payload_PTR)payload;
-		result = SSIRequest((pcb_PTR)senderAddr, ssipyld->service_code, ssipyld->arg);
-		if (result != NOPROC) /* NOPROC is provided when requesting service that doesn't provide any pcb */
-		{					  /* everything went fine, so we obtained the result of the request, now send it back*/
-			SYSCALL(SENDMESSAGE, (unsigned int)senderAddr, result, 0);
+		unsigned int result;
+		if (senderAddr == NULL)
+		{ /* the requester has been freed meanwhile, nobody to serve */
+			senderAddr = (unsigned int *)recvRegMessage(ANYMESSAGE, words);
+			continue;
+		}
+		if (ISSERVICECODE(words[0]))
+			result = SSIRegRequest((pcb_PTR)senderAddr, words);
+		else
+		{
+			ssi_payload_PTR ssipyld = (ssi_payload_PTR)words[0];
+			result = SSIRequest((pcb_PTR)senderAddr, ssipyld->service_code, ssipyld->arg);
+		}
+		if (result != NOREPLY) /* NOREPLY is provided by the services that answer when the request is done */
+		{					  /* everything went fine, so we obtained the result of the request, now send it back
+							  and wait for the next request in the same syscall */
+			senderAddr = (unsigned int *)replyRecvMessage((unsigned int)senderAddr, result, words);
 		}
+		else
+			senderAddr = (unsigned int *)recvRegMessage(ANYMESSAGE, words);
 	}
 }
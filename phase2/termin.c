@@ -0,0 +1,167 @@
+#include "./headers/lib.h"
+
+/* receive ring of every terminal: once a terminal is read through READLINE, its receiver belongs
+   to the ring and the interrupt handler keeps it receiving, one character after the other */
+static termin_t termIn[N_DEV_PER_IL];
+
+/**
+ * @brief Tells if the receiver of a terminal is fed to its ring, so no DoIO may use it.
+ *
+ * @param devNo the terminal number
+ * @return int - 1 if the receiver belongs to the ring
+ */
+int termInArmed(unsigned int devNo)
+{
+    return termIn[devNo].ti_armed;
+}
+
+/**
+ * @brief Asks the receiver of a terminal for the next character.
+ *
+ * @param devNo the terminal number
+ * @return void
+ */
+static void termInReceive(unsigned int devNo)
+{
+    termreg_t *termReg = (termreg_t *)DEV_REG_ADDR(IL_TERMINAL, devNo);
+    termReg->recv_command = RECEIVECHAR;
+}
+
+/**
+ * @brief Tells if a reader of the terminal can be answered: a whole line is in the ring,
+ *        or the ring is full and the line will never fit anyway.
+ *
+ * @param t the ring
+ * @return int - 1 if there is something to read
+ */
+static int termInReady(termin_PTR t)
+{
+    return (t->ti_lines > 0 || t->ti_head - t->ti_tail == TERMINSIZE);
+}
+
+/**
+ * @brief Copies the oldest line of the ring, newline included, in buffer. A line longer than
+ *        length is read in more pieces.
+ *
+ * @param t the ring
+ * @param buffer where the characters are stored, not mapped (it is written from the interrupt handler)
+ * @param length the size of buffer
+ * @return unsigned int - the number of characters copied
+ */
+static unsigned int termInCopy(termin_PTR t, char *buffer, unsigned int length)
+{
+    unsigned int n = 0;
+    while (n < length && t->ti_tail != t->ti_head)
+    {
+        char c = t->ti_buf[t->ti_tail++ % TERMINSIZE];
+        buffer[n++] = c;
+        if (c == '\n')
+        {
+            t->ti_lines--;
+            break;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Handles the line input requests (READLINE): the sender gets the next line typed on the
+ *        terminal, up to length characters. The first request starts the receiver, that is then kept
+ *        receiving by the interrupt handler, so the sender waits only if no whole line is there yet.
+ *
+ * @param devNo the terminal number
+ * @param sender the process that requested the service
+ * @param buffer where the line is stored, not mapped (it is written from the interrupt handler)
+ * @param length the size of buffer
+ * @param count where the number of characters read is stored, if the sender is answered now
+ * @return int - 1 if the sender waits for the line, 0 if it is answered now, -1 if the terminal
+ *         already has a reader or its receiver is used by DoIO requests
+ */
+int termInRead(unsigned int devNo, pcb_PTR sender, char *buffer, unsigned int length, unsigned int *count)
+{
+    termin_PTR t = &termIn[devNo];
+    if (t->ti_reader != NULL || (!t->ti_armed && !list_empty(DEVQUEUE(IL_TERMINAL, devNo, SUBDEVRECV))))
+        return -1;
+    if (!t->ti_armed)
+    {
+        t->ti_armed = 1;
+        termInReceive(devNo);
+    }
+    if (termInReady(t))
+    {
+        *count = termInCopy(t, buffer, length);
+        return 0;
+    }
+    t->ti_reader = sender;
+    t->ti_dest = buffer;
+    t->ti_len = length;
+    softBlockCount++;
+    return 1;
+}
+
+/**
+ * @brief Withdraws the line p waits for, because p is being terminated. The characters stay in the ring.
+ *
+ * @param p the pcb
+ * @return int - 1 if p was waiting for a line, 0 otherwise
+ */
+int termInCancel(pcb_PTR p)
+{
+    for (int i = 0; i < N_DEV_PER_IL; i++)
+    {
+        if (termIn[i].ti_reader == p)
+        {
+            termIn[i].ti_reader = NULL;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Handles a receive interrupt of a terminal whose receiver belongs to the ring. The character
+ *        goes through the line discipline (a backspace erases the last character of the line being typed,
+ *        characters that do not fit are dropped), the receiver is asked for the next one and the reader,
+ *        if any, is woken once a whole line is there. On a receive error the reader gets the negated status.
+ *
+ * @param devNo the terminal number
+ * @param status the recv_status of the terminal
+ * @return void
+ */
+void termInChar(unsigned int devNo, unsigned int status)
+{
+    termin_PTR t = &termIn[devNo];
+    pcb_PTR p = t->ti_reader;
+    if ((status & TERMSTATMASK) != CHARRECV)
+    { /* the receiver stops here, the next READLINE starts it again */
+        t->ti_armed = 0;
+        if (p != NULL)
+        {
+            t->ti_reader = NULL;
+            softBlockCount--;
+            notify(p, NOTIFYDEVICE, -(status & TERMSTATMASK));
+        }
+        return;
+    }
+
+    char c = (char)((status >> BYTELENGTH) & TERMSTATMASK);
+    if (c == '\b')
+    { /* only the line being typed can be edited */
+        if (t->ti_head != t->ti_tail && t->ti_buf[(t->ti_head - 1) % TERMINSIZE] != '\n')
+            t->ti_head--;
+    }
+    else if (t->ti_head - t->ti_tail < TERMINSIZE)
+    {
+        t->ti_buf[t->ti_head++ % TERMINSIZE] = c;
+        if (c == '\n')
+            t->ti_lines++;
+    }
+    termInReceive(devNo);
+
+    if (p != NULL && termInReady(t))
+    {
+        t->ti_reader = NULL;
+        softBlockCount--;
+        notify(p, NOTIFYDEVICE, termInCopy(t, t->ti_dest, t->ti_len));
+    }
+}
@@ -16,10 +16,13 @@ extern support_t supStruct[UPROCMAX];
 extern swap_t swapPoolTable[POOLSIZE];
 
 extern pcb_PTR printerPcbs[UPROCMAX];
+extern spool_t printerSpool[UPROCMAX];
 extern pcb_PTR terminalPcbs[UPROCMAX];
 extern pcb_PTR sstPcbs[UPROCMAX];
 extern pcb_PTR uproc[UPROCMAX];
 extern pcb_PTR mutexSender, testPcb, mutexRecv;
+extern pcb_PTR cleanerPcb;
+extern int cleanerKicked;
 
 void test();
 extern void print();
@@ -34,13 +37,25 @@ void initPeripheralProc(int, int);
 /* SST module */
 void terminate(int);
 void writePrinter(int, sst_print_PTR);
+void flushPrinter(int);
 void writeTerminal(int, sst_print_PTR);
+unsigned int readTerminal(int, sst_print_PTR);
 void SST();
 unsigned int SSTRequest(pcb_PTR, unsigned int, void*, int);
 
 /* vmSupport module */
 void initSwapStructs(int);
+int freeFrames();
+int clockVictim();
 int pick_frame();
+void evictFrame(int);
+void releaseFrames(int);
+void pageCleaner();
+int softFault(support_t *, int);
+void dirtyPage(support_t *, state_t *);
+int loadPage(support_t *, int, memaddr);
+void readAhead(int, int);
+int residentFrame(support_t *, int);
 int isFrameFree(int);
 void interrupts_off();
 void interrupts_on();
@@ -55,10 +70,11 @@ void supSyscallHandler(state_t*);
 void programTrapHandler();
 
 /* utils (p2test ) */
-pcb_PTR create_process(state_t*, support_t*);
+pcb_PTR create_process(state_t*, support_t*, unsigned int);
 support_t *getSupStruct();
 void mutex();
 void askMutex();
-void printDevice(int, int);
+void printTerminal(int);
+void printerSpooler(int);
 void sendKillReq(pcb_PTR);
 #endif
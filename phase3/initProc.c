@@ -18,10 +18,14 @@ swap_t swapPoolTable[POOLSIZE];
 /* these process will be test_pcb children */
 pcb_PTR mutexSender;  /* pcb that listens requests and GIVES the mutex */
 pcb_PTR mutexRecv; /* pcb that RECEIVE and trigger the RELEASE of the mutex */
+pcb_PTR cleanerPcb; /* pcb that keeps free frames in the swap pool */
+int cleanerKicked;  /* 1 if the pager asked the cleaner for frames, under the mutex */
 
 /* specs -> have a process for each device that waits for
 messages and requests the single DoIO to the SSI */
 pcb_PTR printerPcbs[UPROCMAX], terminalPcbs[UPROCMAX];
+/* ring buffers between each sst and its printer spooler, in kernel memory */
+spool_t printerSpool[UPROCMAX];
 /* referring to specs diagram are children of */
 pcb_PTR sstPcbs[UPROCMAX], uproc[UPROCMAX];/* DEBUGGING */
 pcb_PTR testPcb;
@@ -41,68 +45,68 @@ support_t *allocateSupStructs{
    associated with peripheral devices (IL_TERMINAL and IL_PRINTER).
    IL_FLASH will be treated as backing store for uprocs */
 void (*printer0()) { 
-    printDevice(0, IL_PRINTER); 
+    printerSpooler(0); 
     return (void *)0;
 }
 void (*printer1()) {
-    printDevice(1, IL_PRINTER); 
+    printerSpooler(1); 
     return (void *)0;
 }
 void (*printer2()) {
-    printDevice(2, IL_PRINTER); 
+    printerSpooler(2); 
     return (void *)0;
 }
 void (*printer3()) {
-    printDevice(3, IL_PRINTER); 
+    printerSpooler(3); 
     return (void *)0;
 }
 void (*printer4()) {
-    printDevice(4, IL_PRINTER); 
+    printerSpooler(4); 
     return (void *)0;
 }
 void (*printer5()) {
-    printDevice(5, IL_PRINTER); 
+    printerSpooler(5); 
     return (void *)0;
 }
 void (*printer6()) {
-    printDevice(6, IL_PRINTER); 
+    printerSpooler(6); 
     return (void *)0;
 }
 void (*printer7()) {
-    printDevice(7, IL_PRINTER); 
+    printerSpooler(7); 
     return (void *)0;
 }
 
 void (*terminal0()) {
-    printDevice(0, IL_TERMINAL); 
+    printTerminal(0); 
     return (void *)0;
 }
 void (*terminal1()) {
-    printDevice(1, IL_TERMINAL); 
+    printTerminal(1); 
     return (void *)0;
 }
 void (*terminal2()) {
-    printDevice(2, IL_TERMINAL); 
+    printTerminal(2); 
     return (void *)0;
 }
 void (*terminal3()) {
-    printDevice(3, IL_TERMINAL); 
+    printTerminal(3); 
     return (void *)0;
 }
 void (*terminal4()) {
-    printDevice(4, IL_TERMINAL); 
+    printTerminal(4); 
     return (void *)0;
 }
 void (*terminal5()) {
-    printDevice(5, IL_TERMINAL); 
+    printTerminal(5); 
     return (void *)0;
 }
 void (*terminal6()) {
-    printDevice(6, IL_TERMINAL); 
+    printTerminal(6); 
     return (void *)0;
 }
 void (*terminal7()) {
-    printDevice(7, IL_TERMINAL); 
+    printTerminal(7); 
     return (void *)0;
 }
 
@@ -140,6 +144,9 @@ void initSupportStruct()
     for (int asid = 0; asid < UPROCMAX; asid++)
     {
         supStruct[asid].sup_asid = asid + 1;
+        supStruct[asid].sup_imagePages = 0;
+        supStruct[asid].sup_flashed = 0;
+        supStruct[asid].sup_readAhead = 1;
         /* TLB exceptions */
         supStruct[asid].sup_exceptContext[PGFAULTEXCEPT].stackPtr = (memaddr)ramtop;
         supStruct[asid].sup_exceptContext[PGFAULTEXCEPT].status = ALLOFF | IEPON | IMON | TEBITON;
@@ -160,11 +167,11 @@ void initSupportStruct()
         for (int i = 0; i < MAXPAGES - 1; i++)
         {
             supStruct[asid].sup_privatePgTbl[i].pte_entryHI = KUSEG + (i << VPNSHIFT) + ((asid + 1) << ASIDSHIFT);
-            supStruct[asid].sup_privatePgTbl[i].pte_entryLO = DIRTYON;
-        } /* valid bit off and dirty bit on  */
+            supStruct[asid].sup_privatePgTbl[i].pte_entryLO = ALLOFF;
+        } /* valid bit off and dirty bit off: the first write is a TLB-Modification, see pager() */
         /* entry numbered MAXPAGES - 1 -> stack page */
         supStruct[asid].sup_privatePgTbl[MAXPAGES - 1].pte_entryHI = (GETSHAREFLAG - PAGESIZE) + ((asid + 1) << ASIDSHIFT);
-        supStruct[asid].sup_privatePgTbl[MAXPAGES - 1].pte_entryLO = DIRTYON;
+        supStruct[asid].sup_privatePgTbl[MAXPAGES - 1].pte_entryLO = ALLOFF;
     }
 }
 
@@ -197,7 +204,8 @@ void initPeripheralProc(int asid, int devNo)
         printerState[asid].reg_sp = (memaddr)ramtop;
         printerState[asid].status = ALLOFF | IEPON | IMON | TEBITON;
         printerState[asid].entry_hi = (asid + 1) << ASIDSHIFT;
-        printerPcbs[asid] = create_process(&printerState[asid], &supStruct[asid]);
+        printerSpool[asid].sp_head = printerSpool[asid].sp_tail = 0;
+        printerPcbs[asid] = create_process(&printerState[asid], &supStruct[asid], PRIODRIVER);
         break;
     case IL_TERMINAL:
         switch (asid){
@@ -214,7 +222,7 @@ void initPeripheralProc(int asid, int devNo)
         terminalState[asid].reg_sp = (memaddr)ramtop;
         terminalState[asid].status = ALLOFF | IEPON | IMON | TEBITON;
         terminalState[asid].entry_hi = (asid + 1) << ASIDSHIFT;
-        terminalPcbs[asid] = create_process(&terminalState[asid], &supStruct[asid]);
+        terminalPcbs[asid] = create_process(&terminalState[asid], &supStruct[asid], PRIODRIVER);
         break;
     } /* get another frame */
     ramtop -= PAGESIZE;
@@ -241,7 +249,7 @@ void initSST()
         to let the SST create the father -> child association. Technically,
         asid is non-retrievable from the state, hence in this way a certain
         child can inherit father (SST) support struct */
-        sstPcbs[i] = create_process(&sstProcState[i], &supStruct[i]);
+        sstPcbs[i] = create_process(&sstProcState[i], &supStruct[i], PRIOSERVER);
         ramtop -= PAGESIZE;
     }
 }
@@ -273,9 +281,18 @@ void test()
     mutexState.reg_sp = (memaddr)ramtop;
     mutexState.status = ALLOFF | IECON | IMON | TEBITON;
     ramtop -= PAGESIZE;
-    mutexSender = create_process(&mutexState, NULL);
+    mutexSender = create_process(&mutexState, NULL, PRIOSERVER);
     /* mutex request are now active */
 
+    /* page cleaner, it runs in background like the u-procs */
+    state_t cleanerState;
+    cleanerState.pc_epc = (memaddr)pageCleaner;
+    cleanerState.reg_sp = (memaddr)ramtop;
+    cleanerState.status = ALLOFF | IECON | IMON | TEBITON;
+    ramtop -= PAGESIZE;
+    cleanerKicked = 0;
+    cleanerPcb = create_process(&cleanerState, NULL, PRIONORMAL);
+
     /* user process (UPROC)/flash initialization - 10.1 specs */
     /* also SST processes are initialized here (their fathers), 
     or better, structures to create them */
@@ -298,7 +315,7 @@ void test()
     {
         SYSCALL(RECEIVEMESSAGE, (unsigned int)sstPcbs[i], 0, 0);
         /* to make sure that all SST are killed when their job is done */
-        outProcQ(&readyQueue, sstPcbs[i]);
+        outReadyQ(sstPcbs[i]);
         freePcb(sstPcbs[i]);
     } /* kill the test and its progeny */
     sendKillReq(NULL);
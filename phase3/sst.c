@@ -14,11 +14,13 @@
  * @return void
  */
 void terminate(int asid)
-{ /* in case, free the frames */
-    for (int i = 0; i < POOLSIZE; i++){
-        if (swapPoolTable[i].sw_asid == asid) 
-            swapPoolTable[i].sw_asid = NOASID;
-    } /* notify the termination */
+{ /* in case, free the frames, not while the pager or the cleaner is using them */
+    askMutex();
+    releaseFrames(asid + 1); /* asid is the index of the UProc */
+    SYSCALL(SENDMESSAGE, (unsigned int)mutexSender, 0, 0);
+    /* what is still in the spooler is printed before the printer dies */
+    flushPrinter(asid);
+    /* notify the termination */
     SYSCALL(SENDMESSAGE, (unsigned int) testPcb, 0, 0);
     /* since a TerminateProcess kill also the process progeny 
     recursively, one call (that kills the caller) is sufficient */
@@ -30,6 +32,8 @@ void terminate(int asid)
 
 /**
  * @brief This service cause the print of a string of characters to a printer device.
+ *        The string is copied in the ring of the printer spooler, and the service returns
+ *        without waiting for the printer: the sender waits only while the ring is full.
  *        Sender must wait an empty response from the SST.
  *
  * @param int asid - the address space identifier
@@ -38,8 +42,35 @@ void terminate(int asid)
  */
 void writePrinter(int asid, sst_print_PTR print)
 { /* the empty response is sent in SST() */
-    SYSCALL(SENDMESSAGE, (unsigned int)printerPcbs[asid], (unsigned int) print->string, 0);
-    SYSCALL(RECEIVEMESSAGE, (unsigned int)printerPcbs[asid], 0, 0);
+    spool_PTR sp = &printerSpool[asid];
+    char *s = print->string;
+    int len = print->length;
+    unsigned int reply[MSGWORDS];
+    while (len > 0)
+    {
+        if (sp->sp_head - sp->sp_tail == SPOOLSIZE) /* the ring is full, wait for the spooler to print some */
+            callMessage((unsigned int)printerPcbs[asid], SPOOLROOM, 0, 0, 0, reply);
+        while (len > 0 && sp->sp_head - sp->sp_tail < SPOOLSIZE)
+        { /* the character is in the ring before sp_head counts it */
+            sp->sp_buf[sp->sp_head % SPOOLSIZE] = *s++;
+            sp->sp_head++;
+            len--;
+        }
+    } /* the spooler prints the new characters on its own */
+    callMessage((unsigned int)printerPcbs[asid], SPOOLWRITE, 0, 0, 0, reply);
+}
+
+/**
+ * @brief This service waits until every character written to the printer has been printed.
+ *        Sender must wait an empty response from the SST.
+ *
+ * @param int asid - the address space identifier
+ * @return void
+ */
+void flushPrinter(int asid)
+{
+    unsigned int reply[MSGWORDS];
+    callMessage((unsigned int)printerPcbs[asid], SPOOLFLUSH, 0, 0, 0, reply);
 }
 
 /**
@@ -52,8 +83,31 @@ void writePrinter(int asid, sst_print_PTR print)
  */
 void writeTerminal(int asid, sst_print_PTR print)
 { /* the empty response is sent in SST() */
-    SYSCALL(SENDMESSAGE, (unsigned int)terminalPcbs[asid], (unsigned int)print->string, 0);
-    SYSCALL(RECEIVEMESSAGE, (unsigned int)terminalPcbs[asid], 0, 0);
+    unsigned int reply[MSGWORDS];
+    callMessage((unsigned int)terminalPcbs[asid], (unsigned int)print->string, print->length, 0, 0, reply);
+}
+
+/**
+ * @brief This service reads a line from the terminal device, newline included, in the string of the
+ *        sender, up to its length. The line is buffered by the nucleus while it is typed, so the
+ *        SST waits only if no whole line has been typed yet.
+ *
+ * @param asid - the address space identifier
+ * @param sst_print_ptr read - the struct containing the buffer and its size
+ * @return unsigned int - the number of characters read, or the negated device status on error
+ */
+unsigned int readTerminal(int asid, sst_print_PTR read)
+{ /* the nucleus writes the line from the interrupt handler, so in a buffer on the SST stack */
+    char line[MAXSTRLENG];
+    memaddr *command = (memaddr *)(TERM0ADDR) + asid * DEVREGLEN + 1; /* recv_command */
+    unsigned int length = (read->length < MAXSTRLENG) ? read->length : MAXSTRLENG;
+    unsigned int reply[MSGWORDS];
+    if (read->length <= 0)
+        return 0;
+    callMessage((unsigned int)ssi_pcb, READLINE, (unsigned int)command, (unsigned int)line, length, reply);
+    for (int i = 0; i < (int)reply[0]; i++) /* the sst shares the address space of the sender */
+        read->string[i] = line[i];
+    return reply[0];
 }
 
 /**
@@ -85,6 +139,13 @@ unsigned int SSTRequest(pcb_PTR sender, unsigned int service, void *arg, int asi
         writeTerminal(asid, (sst_print_PTR) arg);
         res = ON;
         break;
+    case FLUSHPRINTER:
+        flushPrinter(asid);
+        res = ON;
+        break;
+    case READTERMINAL:
+        res = readTerminal(asid, (sst_print_PTR) arg);
+        break;
 	default:
 		terminate(asid);
         res = ON;
@@ -107,18 +168,19 @@ void SST()
     support_t *sstSup = getSupStruct();
     state_t *sstState = &uProcState[sstSup->sup_asid - 1];
     /* create the child */
-    uproc[sstSup->sup_asid - 1] = create_process(sstState, sstSup);
+    uproc[sstSup->sup_asid - 1] = create_process(sstState, sstSup, PRIONORMAL);
     
+	/* SST children (UPROC) must wait for an answer */
+	unsigned int words[MSGWORDS];
+	unsigned int senderAddr = recvRegMessage(ANYMESSAGE, words);
 	while (1)
-	{   /* SST children (UPROC) must wait for an answer */
-		unsigned int senderAddr, result;
-		pcb_PTR payload;
-		senderAddr = SYSCALL(RECEIVEMESSAGE, ANYMESSAGE, (unsigned int)&payload, 0);
-
+	{
+		unsigned int result;
         /* mind that this is a SST payload, despite the struct it's the same */
-		ssi_payload_PTR sstpyld = (ssi_payload_PTR)payload;
+		ssi_payload_PTR sstpyld = (ssi_payload_PTR)words[0];
 		result = SSTRequest((pcb_PTR)senderAddr, sstpyld->service_code, sstpyld->arg, sstSup->sup_asid - 1);
-        /* everything went fine, so we obtained the result of SST the request, now send it back*/
-	    SYSCALL(SENDMESSAGE, senderAddr, result, 0);
+        /* everything went fine, so we obtained the result of SST the request, now send it back
+        and wait for the next request */
+	    senderAddr = replyRecvMessage(senderAddr, result, words);
 	}
 }
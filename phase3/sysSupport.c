@@ -45,15 +45,14 @@ void supSyscallHandler(state_t *excState)
  */
 void programTrapHandler()
 {
-    for (int i = 0; i < POOLSIZE; i++)
-    { /* clean frames */
-        if (swapPoolTable[i].sw_asid == current_process->p_supportStruct->sup_asid)
-            swapPoolTable[i].sw_asid = NOASID;
-    } /* if the calling process is the mutex holder
-    we need to release it before the termination, otherwise the
-    mutex will be locked indefinetely */
-    if (current_process == mutexRecv)
-        SYSCALL(SENDMESSAGE, (unsigned int)mutexSender, 0, 0); /* send to unblock mutex */
+    /* clean frames, under the mutex since the pager and the cleaner change the spt too;
+    the trap may come from the pager itself, that holds it already */
+    if (current_process != mutexRecv)
+        askMutex();
+    releaseFrames(current_process->p_supportStruct->sup_asid);
+    /* the mutex is released before the termination, otherwise it
+    will be locked indefinetely */
+    SYSCALL(SENDMESSAGE, (unsigned int)mutexSender, 0, 0); /* send to unblock mutex */
     /* kill the calling sst */
     sendKillReq(NULL);
 }
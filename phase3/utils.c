@@ -43,8 +43,8 @@ void mutex()
  */
 void askMutex()
 {
-  SYSCALL(SENDMESSAGE, (unsigned int)mutexSender, 0, 0);
-  SYSCALL(RECEIVEMESSAGE, (unsigned int)mutexSender, 0, 0);
+  unsigned int reply[MSGWORDS];
+  callMessage((unsigned int)mutexSender, 0, 0, 0, 0, reply);
 }
 
 
@@ -54,42 +54,27 @@ void askMutex()
  *
  * @param state_t - state of the pcb to create
  * @param support_t - support struct (to inherit) of the pcb to create
+ * @param unsigned int - ready queue priority of the pcb to create
  * @return the pcb pointer to the newly created process
  */
-pcb_PTR create_process(state_t *s, support_t *sup)
-{ /* Protocol: send a msg to ssi -> await for response -> return its pcb */
-    pcb_PTR p;
-    ssi_create_process_t ssi_create_process = {
-        .state = s,
-        .support = sup,
-    };
-    ssi_payload_t payload = {
-        .service_code = CREATEPROCESS,
-        .arg = &ssi_create_process,
-    };
-    SYSCALL(SENDMESSAGE, (unsigned int)ssi_pcb, (unsigned int)&payload, 0);
-    SYSCALL(RECEIVEMESSAGE, (unsigned int)ssi_pcb, (unsigned int)(&p), 0);
-    return p;
+pcb_PTR create_process(state_t *s, support_t *sup, unsigned int prio)
+{ /* Protocol: call the ssi -> return its pcb */
+    unsigned int reply[MSGWORDS]; /* state, support and priority travel inline in the request */
+    callMessage((unsigned int)ssi_pcb, CREATEPROCESS, (unsigned int)s, (unsigned int)sup, prio, reply);
+    return (pcb_PTR)reply[0];
 }
 
 /**
- * @brief Get the support struct requesting the associated service
- *        to the ssi process. The service returns a pointer to the support
- *        struct of current_process, that will be inherited by its child.
+ * @brief Get the support struct of current_process, that will be inherited by its child.
+ *        It is read by the nucleus directly (FASTGETSUPPORTPTR), without a round trip
+ *        to the ssi process, since this runs on every page fault and support exception.
  *
  * @param void
  * @return
  */
 support_t *getSupStruct()
-{ /* Protocol: send a msg to ssi -> await for response -> return sup */
-    support_t *sup;
-    ssi_payload_t getsup_payload = {
-        .service_code = GETSUPPORTPTR,
-        .arg = NULL,
-    };
-    SYSCALL(SENDMESSAGE, (unsigned int)ssi_pcb, (unsigned int)(&getsup_payload), 0);
-    SYSCALL(RECEIVEMESSAGE, (unsigned int)ssi_pcb, (unsigned int)(&sup), 0);
-    return sup;
+{
+    return (support_t *)SYSCALL(FASTGETSUPPORTPTR, 0, 0, 0);
 }
 
 /**
@@ -101,74 +86,98 @@ support_t *getSupStruct()
  */
 void sendKillReq(pcb_PTR p)
 {
-    ssi_payload_t term_process_payload = {
-        .service_code = TERMPROCESS,
-        .arg = (void *)p,
-    };
-    SYSCALL(SENDMESSAGE, (unsigned int)ssi_pcb, (unsigned int)(&term_process_payload), 0);
-    SYSCALL(RECEIVEMESSAGE, (unsigned int)ssi_pcb, 0, 0);
+    unsigned int reply[MSGWORDS];
+    callMessage((unsigned int)ssi_pcb, TERMPROCESS, (unsigned int)p, 0, 0, reply);
 }
 
 /**
- * @brief  Print a string of characters after operations on backing stores on terminal/printer
- *         devices. The string and its length it's retrieved by the SST with
- *         message passing and then printed with SSI doio service.
- *         All values (base, command, data0) are calculated accorting to umps - pops
+ * @brief  Printer spooler: prints the characters the SST puts in the ring of the printer,
+ *         asynchronously with respect to the SST. Each run of characters up to the end of the ring
+ *         is printed with a single DOIOSTRING, sent without waiting: the completion is a message
+ *         from the SSI like the requests of the SST, so the spooler keeps serving both.
+ *         The ring is kernel memory, so the nucleus can read it from the interrupt handler.
  *
- * @param int asid - index of the device
- * @param int deviceType - identifies type of device (terminal/printer)
+ * @param int asid - index of the printer
  * @return void
  */
-void printDevice(int asid, int deviceType)
+void printerSpooler(int asid)
 {
+    spool_PTR sp = &printerSpool[asid];
+    devregtr *command = (devregtr *)(PRINT0ADDR) + asid * DEVREGLEN + 1; /* COMMAND field p28 pops */
+    unsigned int words[MSGWORDS];
+    unsigned int busy = 0;    /* characters the printer is printing, 0 if idle */
+    unsigned int waiter = 0;  /* the sst waiting for room or for the flush, 0 if none */
+    unsigned int waitFor = 0; /* SPOOLROOM or SPOOLFLUSH */
     while (1)
     {
-        /* get the sst_print_t pointer in which we found the string to print,
-        the message is sent by the writeX, where X is the device type */
-        char *msg;                                       /* char that starts the print */
-        unsigned int sender = SYSCALL(RECEIVEMESSAGE, ANYMESSAGE, (unsigned int)(&msg), 0);
-        devregtr *base, *command, *data0, status, value; /* device register values */
-        switch (deviceType)
+        if (busy == 0 && sp->sp_head != sp->sp_tail)
+        { /* print the characters up to sp_head, or up to the end of the ring */
+            unsigned int start = sp->sp_tail % SPOOLSIZE;
+            unsigned int count = sp->sp_head - sp->sp_tail;
+            busy = (count < SPOOLSIZE - start) ? count : SPOOLSIZE - start;
+            sendRegMessage((unsigned int)ssi_pcb, DOIOSTRING, (unsigned int)command, (unsigned int)&sp->sp_buf[start], busy);
+        }
+        if (waiter != 0 && ((waitFor == SPOOLROOM && sp->sp_head - sp->sp_tail < SPOOLSIZE) ||
+                            (waitFor == SPOOLFLUSH && busy == 0 && sp->sp_head == sp->sp_tail)))
+        { /* unblock sst */
+            sendRegMessage(waiter, 0, 0, 0, 0);
+            waiter = 0;
+        }
+
+        unsigned int sender = recvRegMessage(ANYMESSAGE, words);
+        if (sender == (unsigned int)ssi_pcb)
+        { /* the run is printed, a failed one is dropped all the same */
+            sp->sp_tail += busy;
+            busy = 0;
+        }
+        else if (words[0] == SPOOLWRITE)
+            sendRegMessage(sender, 0, 0, 0, 0);
+        else
         {
-        case IL_PRINTER:                     /* pops p.39 for printers */
-            base = (devregtr *)(PRINT0ADDR); /* base device address for printer */
-            base += asid * DEVREGLEN;        /* offset for the device */
-            command = base + 1;              /* COMMAND field p28 pops */
-            data0 = base + 2;                /* DATA0 field where to put char to print */
-            break;
-        case IL_TERMINAL:                    /* pops p.41 for terminals */
-            base = (devregtr *)(TERM0ADDR);  /* base device address for terminal 0 */
-            base += asid * DEVREGLEN;        /* offset for the device */
-            /* this because there are 4 (0-3) possible fields in the layout, so
-            (0-3) is the field layout for devNo 0, and (4-7) for devNo 1 */
-            data0 = base + 2; /* we want TRANSM_COMMAND that is in fact 3rd and last field */
-            command = base + TRANCOMMAND;
-            break;
+            waiter = sender;
+            waitFor = words[0];
         }
-        while (*msg != EOS)
-        { /* iterating until we reach the null-term of the string, char by char */
-            switch (deviceType)
-            {
-            case IL_PRINTER: /* printer transmit the char in data0 over the line */
-                *data0 = (devregtr)*msg;
-                value = PRINTCHR;
-                break;
-            case IL_TERMINAL: /* terminal don't use data0 at all */
-                value = PRINTCHR | (((devregtr)*msg) << BYTELENGTH);
-                break;
-            } /* prepping the doio payload for requesting doio service to sssi */
-            ssi_do_io_t do_io = {
-                .commandAddr = command,
-                .commandValue = value,
-            };
-            ssi_payload_t payload = {
-                .service_code = DOIO,
-                .arg = &do_io,
-            };
-            SYSCALL(SENDMESSAGE, (unsigned int)ssi_pcb, (unsigned int)(&payload), 0);
-            SYSCALL(RECEIVEMESSAGE, (unsigned int)ssi_pcb, (unsigned int)(&status), 0);
-            msg++;
-        } /* unblock sst */
-        SYSCALL(SENDMESSAGE, (unsigned int)sender, 0, 0);
+    }
+}
+
+/**
+ * @brief  Print a string of characters on a terminal device (printers go through
+ *         printerSpooler). The string and its length it's retrieved by the SST with
+ *         message passing and then printed with a single SSI DOIOSTRING request:
+ *         the nucleus sends the characters one by one from the interrupt handler.
+ *         The string lives in the kuseg of the UProc, that the nucleus can't read from an
+ *         interrupt, so it is copied on the stack of this process first, MAXSTRLENG chars at a time.
+ *         All values (base, command) are calculated accorting to umps - pops
+ *
+ * @param int asid - index of the device
+ * @return void
+ */
+void printTerminal(int asid)
+{
+    /* get the string to print and its length, the message is sent by the writeX,
+    where X is the device type */
+    unsigned int words[MSGWORDS];
+    unsigned int sender = recvRegMessage(ANYMESSAGE, words);
+    /* pops p.41 for terminals */
+    devregtr *base = (devregtr *)(TERM0ADDR); /* base device address for terminal 0 */
+    base += asid * DEVREGLEN;                 /* offset for the device */
+    /* we want TRANSM_COMMAND that is in fact the last field of the terminal register */
+    devregtr *command = base + TRANCOMMAND;
+    while (1)
+    {
+        char *msg = (char *)words[0];     /* char that starts the print */
+        unsigned int len = words[1];      /* characters left to print */
+        char buf[MAXSTRLENG];             /* unmapped copy of the next chunk */
+        unsigned int status[MSGWORDS];
+        while (len > 0)
+        {
+            unsigned int chunk = (len < MAXSTRLENG) ? len : MAXSTRLENG;
+            for (unsigned int i = 0; i < chunk; i++)
+                buf[i] = msg[i];
+            callMessage((unsigned int)ssi_pcb, DOIOSTRING, (unsigned int)command, (unsigned int)buf, chunk, status);
+            msg += chunk;
+            len -= chunk;
+        } /* unblock sst and wait for the next string */
+        sender = replyRecvMessage(sender, 0, words);
     }
 }
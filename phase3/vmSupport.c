@@ -18,6 +18,31 @@ void initSwapStructs(int entryid)
   swapPoolTable[entryid].sw_asid = NOASID;
   swapPoolTable[entryid].sw_pageNo = NOPAGE;
   swapPoolTable[entryid].sw_pte = NULL;
+  swapPoolTable[entryid].sw_ref = 0;
+  swapPoolTable[entryid].sw_ahead = 0;
+  swapPoolTable[entryid].sw_busy = 0;
+}
+
+/**
+ * @brief Free the frames of a terminated UProc. A frame the cleaner is reading or writing is
+ *        only marked, the cleaner frees it when the I/O is over. No more pages are read ahead for it.
+ *        Must be called with the mutex over the spt.
+ *
+ * @param int asid - the address space identifier of the UProc
+ * @return void
+ */
+void releaseFrames(int asid)
+{
+  for (int i = 0; i < POOLSIZE; i++)
+  {
+    if (swapPoolTable[i].sw_asid != asid)
+      continue;
+    if (swapPoolTable[i].sw_busy)
+      swapPoolTable[i].sw_pageNo = NOPAGE;
+    else
+      swapPoolTable[i].sw_asid = NOASID;
+  }
+  supStruct[asid - 1].sup_readAhead = 0;
 }
 
 /**
@@ -55,23 +80,253 @@ void interrupts_on()
   setSTATUS(getSTATUS() | IECON);
 }
 
+/**
+ * @brief Count the free frames in the swap pool table.
+ *
+ * @param void
+ * @return int - the number of free frames
+ */
+int freeFrames()
+{
+  int n = 0;
+  for (int i = 0; i < POOLSIZE; i++)
+    n += isFrameFree(i);
+  return n;
+}
+
+/**
+ * @brief Choose the victim among the occupied frames with Clock (second chance): the hand sweeps
+ *        the pool, and a page referenced since the last sweep loses its reference bit and gets one
+ *        more round, while the first page not referenced is the victim.
+ *        uMPS3 has no hardware reference bit, so the hand also clears VALIDON of the pages it
+ *        spares: the next access refaults, and softFault() sets the bit back without any I/O.
+ *        Pages being written back by the cleaner are skipped. At least one frame must be
+ *        occupied and not busy.
+ *
+ * @param void
+ * @return int - the frame number of the victim
+ */
+int clockVictim()
+{
+  static int hand = 0; /* next frame the clock looks at */
+  while (isFrameFree(hand) || swapPoolTable[hand].sw_busy || swapPoolTable[hand].sw_ref)
+  { /* second chance, the page is referenced again only if it is used before the hand is back */
+    swap_t *spte = &swapPoolTable[hand];
+    if (!isFrameFree(hand) && !spte->sw_busy)
+    {
+      spte->sw_ref = 0;
+      interrupts_off();
+      spte->sw_pte->pte_entryLO &= ~VALIDON;
+      updateTLB(*spte->sw_pte);
+      interrupts_on();
+    }
+    hand = (hand + 1) % POOLSIZE;
+  }
+  int victim = hand;
+  hand = (hand + 1) % POOLSIZE;
+  return victim;
+}
+
 /**
  * @brief Pick a frame from the SPT according to a replacement algorithm.
- *        The algorithm is a simple FIFO, that returns the first free frame found.
- *        If no free frame is found, the algorithm returns the first frame in the pool.
+ *        The first free frame found is returned, otherwise the victim of the clock.
  *
  * @param void
  * @return int - the frame number of the free/victimized page
  */
 int pick_frame()
 {
-  static int counter = -1; /* correction, -> this was an unsigned int */
   for (int i = 0; i < POOLSIZE; i++)
   {
     if (isFrameFree(i))
       return i;
-  } /* increment mod POOLSIZE */
-  return (counter++ % POOLSIZE);
+  }
+  return clockVictim();
+}
+
+/**
+ * @brief Make the page in an occupied frame not valid, before it is victimized.
+ *        Must be called with the mutex over the spt.
+ *
+ * @param int frame - the frame number
+ * @return int - 1 if the page is dirty and must be written back
+ */
+static int invalidateFrame(int frame)
+{
+  swap_t *spte = &swapPoolTable[frame];
+
+  /* mark page as not valid, atomically disabiliting interrupts - 5.3 specs */
+  /* update also the TLB, if needed */
+  interrupts_off();
+  pteEntry_t *victimizedPte = spte->sw_pte;
+  int dirty = victimizedPte->pte_entryLO & DIRTYON;
+  victimizedPte->pte_entryLO &= ~(VALIDON | DIRTYON); /* mark the page as not valid, and clean */
+  updateTLB(*victimizedPte);
+  interrupts_on();
+
+  if (spte->sw_ahead)
+  { /* read ahead for nothing, next time it reads less */
+    support_t *owner = &supStruct[spte->sw_asid - 1];
+    if (owner->sup_readAhead > 1)
+      owner->sup_readAhead /= 2;
+  }
+  return dirty;
+}
+
+/**
+ * @brief Evict the page in an occupied frame: the page is made not valid, written back to the
+ *        backing store if it is dirty, and the frame is free. Must be called with the mutex over the spt,
+ *        by the pager of the faulting UProc.
+ *
+ * @param int frame - the frame number
+ * @return void
+ */
+void evictFrame(int frame)
+{
+  swap_t *spte = &swapPoolTable[frame];
+  memaddr frameAddr = SWAPPOOL + (frame * PAGESIZE);
+  /* the entry is read once: terminate() may free it while the page is being written back */
+  int asid = spte->sw_asid;
+  int pageNo = spte->sw_pageNo;
+  int dirty = invalidateFrame(frame);
+
+  /* write on backing store, a page never written is the same as its copy there */
+  if (dirty)
+  {
+    if (flashOp(asid, pageNo, frameAddr, FLASHWRITE) != READY)
+      programTrapHandler(); /* treat any write/read error on devices as a progtrap */
+    supStruct[asid - 1].sup_flashed |= 1U << pageNo;
+  }
+  initSwapStructs(frame);
+}
+
+/**
+ * @brief Write back the dirty victim of the cleaner. The mutex is released during the write,
+ *        so the page faults go on meanwhile: the frame is busy, so the clock skips it. If the owner
+ *        touches the page meanwhile, softFault() makes it valid again and the frame is kept; if the
+ *        owner terminates, releaseFrames() leaves the frame to be freed here.
+ *        Must be called with the mutex over the spt, that is held again on return.
+ *
+ * @param int frame - the frame number, already invalidated
+ * @return int - 0 if the write failed, and the cleaning must stop, 1 otherwise
+ */
+static int cleanFrame(int frame)
+{
+  swap_t *spte = &swapPoolTable[frame];
+  int asid = spte->sw_asid;
+  int pageNo = spte->sw_pageNo;
+  spte->sw_busy = 1;
+  SYSCALL(SENDMESSAGE, (unsigned int)mutexSender, 0, 0);
+
+  int status = flashOp(asid, pageNo, SWAPPOOL + (frame * PAGESIZE), FLASHWRITE);
+
+  askMutex();
+  if (spte->sw_pageNo == NOPAGE)
+  { /* the owner terminated during the write */
+    initSwapStructs(frame);
+    return 1;
+  }
+  if (status != READY)
+  { /* the cleaner has no UProc to kill: the page stays, dirty, for the pager to try again */
+    spte->sw_busy = 0;
+    interrupts_off();
+    spte->sw_pte->pte_entryLO |= DIRTYON;
+    updateTLB(*spte->sw_pte);
+    interrupts_on();
+    return 0;
+  }
+  supStruct[asid - 1].sup_flashed |= 1U << pageNo;
+  if (spte->sw_busy) /* not used again meanwhile */
+    initSwapStructs(frame);
+  return 1;
+}
+
+/**
+ * @brief Page cleaner process. When the pager finds less than FREELOW free frames it asks the
+ *        cleaner for more (PAGECLEAN), and the cleaner evicts the victims of the clock until FREEHIGH
+ *        frames are free, so that a page fault usually finds a free frame and needs a single read.
+ *        Clean victims are freed at once, dirty ones are written back by cleanFrame() without
+ *        holding the mutex. The cleaner also reads ahead for the pager (PAGEAHEAD), so that the
+ *        faulting UProc does not wait for those reads.
+ *
+ * @param void
+ * @return void
+ */
+void pageCleaner()
+{
+  unsigned int words[MSGWORDS];
+  while (1)
+  {
+    recvRegMessage(ANYMESSAGE, words);
+    if (words[0] == PAGEAHEAD)
+    {
+      readAhead(words[1], words[2]);
+      continue;
+    }
+    askMutex();
+    cleanerKicked = 0;
+    while (freeFrames() < FREEHIGH)
+    {
+      int victim = clockVictim();
+      if (!invalidateFrame(victim))
+        initSwapStructs(victim);
+      else if (!cleanFrame(victim))
+        break; /* the flash fails, the page faults will report it */
+    }
+    SYSCALL(SENDMESSAGE, (unsigned int)mutexSender, 0, 0);
+  }
+}
+
+/**
+ * @brief Find the frame that holds page p of a UProc, if the page is still in the swap pool.
+ *        The PTE keeps the address of the last frame of the page, so the frame is resident if
+ *        its swap pool entry still names the page. Must be called with the mutex over the spt.
+ *
+ * @param support_t *sup - the support structure of the UProc
+ * @param int p - the page number
+ * @return int - the frame number, -1 if the page is not resident
+ */
+int residentFrame(support_t *sup, int p)
+{
+  memaddr frameAddr = sup->sup_privatePgTbl[p].pte_entryLO & PFNMASK; /* the frame the page had last time */
+  if (frameAddr < SWAPPOOL || frameAddr >= SWAPPOOL + POOLSIZE * PAGESIZE)
+    return -1;
+  int frame = (frameAddr - SWAPPOOL) / PAGESIZE;
+  if (swapPoolTable[frame].sw_asid != sup->sup_asid || swapPoolTable[frame].sw_pageNo != p)
+    return -1; /* the frame now holds another page */
+  return frame;
+}
+
+/**
+ * @brief Handle a page fault on a page that is still in the swap pool, but was made invalid
+ *        by the clock hand to see if it is used: the page is valid again and referenced.
+ *        Must be called with the mutex over the spt.
+ *
+ * @param support_t *sup - the support structure of the faulting process
+ * @param int p - the missing page number
+ * @return int - 1 if the page was resident, 0 if it must be read from the backing store
+ */
+int softFault(support_t *sup, int p)
+{
+  pteEntry_t *pte = &sup->sup_privatePgTbl[p];
+  int frame = residentFrame(sup, p);
+  if (frame < 0)
+    return 0;
+  swap_t *spte = &swapPoolTable[frame];
+
+  if (spte->sw_ahead)
+  { /* the read-ahead paid off, next time it goes further */
+    spte->sw_ahead = 0;
+    if (sup->sup_readAhead < READAHEADMAX)
+      sup->sup_readAhead++;
+  }
+  spte->sw_ref = 1;
+  spte->sw_busy = 0; /* if the cleaner is writing it back, it keeps the frame */
+  interrupts_off();
+  pte->pte_entryLO |= VALIDON;
+  updateTLB(*pte);
+  interrupts_on();
+  return 1;
 }
 
 /**
@@ -108,23 +363,149 @@ int flashOp(int asid, int block, memaddr pageAddr, int operation)
 { /* take the register as a non-terminal device register
   interruptLine 4 is associated with flash devices, and the devNo
   depends on which backing store we're considering (so it depends on UProc asid) */
-  unsigned int s;
+  unsigned int s[MSGWORDS];
   devreg_t *flashReg = (devreg_t *)DEV_REG_ADDR(FLASHINT, asid - 1);
-  flashReg->dtp.data0 = pageAddr; /* load the page address, 4k block to read/write */
 
   /* pops p.35 - an operation on a flash device is started by loading the
-  appropriate value into the COMMAND field. */
-  ssi_do_io_t do_io = { /* doio service */
-      .commandAddr = &(flashReg->dtp.command),
-      .commandValue = (block << BYTELENGTH) | operation,
-  }; /* write on BLOCKNUMBER (24bit) shifting 1byte sx */
-  ssi_payload_t payload = {
-      .service_code = DOIO,
-      .arg = &do_io,
-  }; /* send the service request to the SSi */
-  SYSCALL(SENDMESSAGE, (unsigned int)ssi_pcb, (unsigned int)&payload, 0);
-  SYSCALL(RECEIVEMESSAGE, (unsigned int)ssi_pcb, (unsigned int)&s, 0);
-  return s;
+  appropriate value into the COMMAND field. The doio request travels inline,
+  write on BLOCKNUMBER (24bit) shifting 1byte sx. The page address (the 4k block
+  to read/write) goes with it: the pager and the cleaner may queue on the same flash,
+  so DATA0 is loaded by the ssi only when this command is issued */
+  callMessage((unsigned int)ssi_pcb, DOIO, (unsigned int)&(flashReg->dtp.command),
+              (block << BYTELENGTH) | operation, pageAddr, s);
+  return s[0];
+}
+
+/**
+ * @brief Handle a TLB-Modification exception, that is the first write on a page since it was read
+ *        from the backing store: pages are mapped with DIRTYON off, so DIRTYON is the dirty bit
+ *        of the page and only dirty pages are written back when they are victimized.
+ *        If the page has been victimized meanwhile the write faults again as a page fault.
+ *
+ * @param support_t *sup - the support structure of the faulting process
+ * @param state_t *supState - the state of the faulting process
+ * @return void
+ */
+void dirtyPage(support_t *sup, state_t *supState)
+{
+  int p = ENTRYHI_GET_VPN(supState->entry_hi);
+  if (p > MAXPAGES - 1)  /* bound check */
+    p = MAXPAGES - 1;
+
+  askMutex(); /* a victim is not written back while its dirty bit is being set */
+  pteEntry_t *pte = &sup->sup_privatePgTbl[p];
+  interrupts_off();
+  if (pte->pte_entryLO & VALIDON)
+  {
+    pte->pte_entryLO |= DIRTYON;
+    updateTLB(*pte);
+  }
+  interrupts_on();
+  SYSCALL(SENDMESSAGE, (unsigned int)mutexSender, 0, 0);
+  LDST(supState);
+}
+
+/**
+ * @brief Fill a frame with page p of a U-proc. Only the pages of the .aout image (.text and .data)
+ *        and the pages written back since are read from the backing store: the others (.bss, heap and
+ *        the stack) have no contents there, and they are zeroed. The image size is taken from the
+ *        .aout header, read with page 0 at the first page fault of the U-proc.
+ *
+ * @param support_t *sup - the support structure of the faulting process
+ * @param int p - the missing page number
+ * @param memaddr frameAddr - the address of the frame
+ * @return int - 1 if the page was read from the backing store, 0 if it was zeroed
+ */
+int loadPage(support_t *sup, int p, memaddr frameAddr)
+{
+  if (sup->sup_imagePages == 0)
+  { /* page 0 starts with the header */
+    if (flashOp(sup->sup_asid, 0, frameAddr, FLASHREAD) != READY)
+      programTrapHandler();
+    memaddr *aout = (memaddr *)frameAddr;
+    sup->sup_imagePages = (aout[AOUTTEXTFILESZ] + aout[AOUTDATAFILESZ] + PAGESIZE - 1) / PAGESIZE;
+    if (sup->sup_imagePages == 0 || sup->sup_imagePages > MAXPAGES - 1)
+      sup->sup_imagePages = MAXPAGES - 1; /* not a sane header, all but the stack are read */
+    if (p == 0)
+      return 1;
+  }
+
+  if (p < sup->sup_imagePages || (sup->sup_flashed & (1U << p)))
+  {
+    if (flashOp(sup->sup_asid, p, frameAddr, FLASHREAD) != READY)
+      programTrapHandler();
+    return 1;
+  }
+  /* zero-fill on demand */
+  memaddr *word = (memaddr *)frameAddr;
+  for (int i = 0; i < PAGESIZE / WORDLEN; i++)
+    word[i] = 0;
+  return 0;
+}
+
+/**
+ * @brief Read ahead the pages that follow a page read from the backing store, as long as they are
+ *        on the backing store too, not resident, and more than FREELOW frames are free (no page is
+ *        victimized). Run by the page cleaner, not by the faulting UProc, and each read is done
+ *        without the mutex on a busy frame: the page is published only if it was not faulted in
+ *        meanwhile and its UProc is still alive.
+ *        A page read ahead is resident but not valid: its first access is a soft fault, that tells
+ *        the read-ahead was useful and widens it, while victimizing it unused narrows it.
+ *
+ * @param int asid - the address space identifier of the UProc
+ * @param int p - the page just read
+ * @return void
+ */
+void readAhead(int asid, int p)
+{
+  support_t *sup = &supStruct[asid - 1];
+  askMutex();
+  for (int q = p + 1; q <= p + (int)sup->sup_readAhead && q < MAXPAGES - 1; q++)
+  {
+    if (q >= (int)sup->sup_imagePages && !(sup->sup_flashed & (1U << q)))
+      break; /* nothing to read there, it will be zeroed */
+    if (residentFrame(sup, q) >= 0)
+      continue;
+    if (freeFrames() <= FREELOW)
+      break; /* the free frames are kept for the page faults */
+    int frame = 0;
+    while (!isFrameFree(frame))
+      frame++;
+
+    /* the frame is taken, but not reachable from the PTE until the page is in: the PTE may
+    still name this frame from a past residence, so its PFN is cleared, or a page fault on q
+    during the read would take the frame as resident (see residentFrame()) */
+    swap_t *spte = &swapPoolTable[frame];
+    pteEntry_t *pte = &sup->sup_privatePgTbl[q];
+    spte->sw_asid = asid;
+    spte->sw_pageNo = q;
+    spte->sw_pte = pte;
+    spte->sw_busy = 1;
+    spte->sw_ref = 0;
+    interrupts_off();
+    pte->pte_entryLO &= ~PFNMASK;
+    interrupts_on();
+    SYSCALL(SENDMESSAGE, (unsigned int)mutexSender, 0, 0);
+
+    memaddr frameAddr = SWAPPOOL + (frame * PAGESIZE);
+    int status = flashOp(asid, q, frameAddr, FLASHREAD);
+
+    askMutex();
+    int resident = residentFrame(sup, q);
+    if (spte->sw_pageNo == NOPAGE || status != READY || (resident >= 0 && resident != frame))
+    { /* terminated, failed (the page fault will tell, if it is ever needed) or faulted in meanwhile */
+      initSwapStructs(frame);
+      if (status != READY)
+        break;
+      continue;
+    }
+    spte->sw_busy = 0;
+    spte->sw_ahead = 1;
+    interrupts_off();
+    pte->pte_entryLO = (pte->pte_entryLO & 0xFFF & ~(VALIDON | DIRTYON)) | frameAddr;
+    interrupts_on();
+  }
+  SYSCALL(SENDMESSAGE, (unsigned int)mutexSender, 0, 0);
 }
 
 /**
@@ -140,7 +521,7 @@ void pager()
   /* detrmine the cause of the TLB exception occurred */
   state_t *supState = &sup->sup_exceptState[PGFAULTEXCEPT];
   if (CAUSE_GET_EXCCODE(supState->cause) == TLBINVLDM) /* TLB-modification */
-    programTrapHandler();                              /* treat it as progtrap */
+    dirtyPage(sup, supState);                          /* first write on the page */
 
   /* gain mutual exclusion over the spt */
   askMutex();
@@ -149,46 +530,54 @@ void pager()
   if (p > MAXPAGES - 1)  /* bound check */
     p = MAXPAGES - 1;
 
+  if (softFault(sup, p))
+  { /* only the clock made the page invalid, no need of the backing store */
+    SYSCALL(SENDMESSAGE, (unsigned int)mutexSender, 0, 0);
+    LDST(supState);
+  }
+
   /* get a frame from the swap pool with a replacement algo,
     determining if it's free and can contain a page */
   int victimizedPgNo = pick_frame();
   swap_t *spte = &swapPoolTable[victimizedPgNo];
   unsigned int victimizedPgAddr = SWAPPOOL + (victimizedPgNo * PAGESIZE);
 
-  /* check if the frame is currently occupied */
+  /* check if the frame is currently occupied, the cleaner could not keep up */
   if (!isFrameFree(victimizedPgNo))
-  { /* mark page as not valid, atomically disabiliting interrupts - 5.3 specs */
-    /* update also the TLB, if needed */
-    interrupts_off();
-    pteEntry_t *victimizedPte = spte->sw_pte;
-    victimizedPte->pte_entryLO &= ~VALIDON; /* mark the page as not valid */
-    updateTLB(*victimizedPte);
-    interrupts_on();
-
-    /* write on backing store */
-    if (flashOp(spte->sw_asid, spte->sw_pageNo, victimizedPgAddr, FLASHWRITE) != READY)
-      programTrapHandler(); /* treat any write/read error on devices as a progtrap */
-  } 
+    evictFrame(victimizedPgNo);
 
-  /* read from backing store */
-  if (flashOp(sup->sup_asid, p, victimizedPgAddr, FLASHREAD) != READY)
-    programTrapHandler();
+  /* read from backing store, or zero-fill */
+  int fromFlash = loadPage(sup, p, victimizedPgAddr);
 
   /* update the swap pool table */
   spte->sw_asid = sup->sup_asid;
   spte->sw_pageNo = p;
   spte->sw_pte = &sup->sup_privatePgTbl[p];
+  spte->sw_ref = 1;
+  spte->sw_ahead = 0;
 
   /* update the current process page table entry */
   interrupts_off();
-  sup->sup_privatePgTbl[p].pte_entryLO |= VALIDON | DIRTYON;
-  sup->sup_privatePgTbl[p].pte_entryLO &= 0xFFF;
+  sup->sup_privatePgTbl[p].pte_entryLO |= VALIDON;
+  sup->sup_privatePgTbl[p].pte_entryLO &= 0xFFF & ~DIRTYON;
   /* correction -> clear the PNF but preserve the last 12 bits */
-  sup->sup_privatePgTbl[p].pte_entryLO |=  victimizedPgAddr; /* mark the page as valid and dirty */
+  sup->sup_privatePgTbl[p].pte_entryLO |=  victimizedPgAddr; /* mark the page as valid and clean */
   updateTLB(sup->sup_privatePgTbl[p]);
   interrupts_on();
 
+  /* free frames for the next page faults are made in background */
+  if (!cleanerKicked && freeFrames() < FREELOW)
+  {
+    cleanerKicked = 1;
+    sendRegMessage((unsigned int)cleanerPcb, PAGECLEAN, 0, 0, 0);
+  }
+
   /* release the mutex */
   SYSCALL(SENDMESSAGE, (unsigned int)mutexSender, 0, 0);
+
+  /* the next pages are likely to be needed soon, as a U-proc walks its text:
+    the cleaner reads them in background, while this one goes on */
+  if (fromFlash)
+    sendRegMessage((unsigned int)cleanerPcb, PAGEAHEAD, sup->sup_asid, p, 0);
   LDST(supState);
 }
@@ -5,9 +5,14 @@
 #define TERMINATE 2
 #define WRITEPRINTER 3
 #define WRITETERMINAL 4
+#define FLUSHPRINTER 5
+#define READTERMINAL 6
 
 #define PARENT 0
 
 #define SENDMSG 1
 #define RECEIVEMSG 2
 
+#define PAGESIZE 4096
+#define SPOOLSIZE 512
+
@@ -0,0 +1,85 @@
+/*	Test of the support level services: reads a line from the terminal,
+ *	writes more than a spooler ring to the printer and waits for it, then
+ *	touches more pages than the swap pool frames, so that pages are
+ *	written back and read again */
+
+#include <umps/libumps.h>
+
+#include "h/tconst.h"
+#include "h/print.h"
+#include "h/types.h"
+
+#define LINELEN 64
+#define PRINTLINES ((2 * SPOOLSIZE) / LINELEN) /* twice the spooler ring */
+#define TESTPAGES 20 /* more than the swap pool frames */
+
+char pages[TESTPAGES][PAGESIZE];
+char text[PRINTLINES * LINELEN];
+
+int sstCall(int service_code, char *str, int len) {
+	unsigned int res;
+	sst_print_t print_payload = {
+		.length = len,
+		.string = str,
+	};
+	ssi_payload_t sst_payload = {
+		.service_code = service_code,
+		.arg = &print_payload,
+	};
+	SYSCALL(SENDMSG, PARENT, (unsigned int)&sst_payload, 0);
+	SYSCALL(RECEIVEMSG, PARENT, (unsigned int)&res, 0);
+	return res;
+}
+
+void main() {
+	char line[LINELEN + 1];
+	int i, j, len;
+	print(WRITETERMINAL, "Support Test starts\nType a line: ");
+
+	/* READTERMINAL */
+	len = sstCall(READTERMINAL, line, LINELEN);
+	if (len > 0 && len <= LINELEN) {
+		line[len] = EOS;
+		print(WRITETERMINAL, "Read: ");
+		print(WRITETERMINAL, line);
+		print(WRITETERMINAL, "\n");
+	} else {
+		print(WRITETERMINAL, "ERROR: READTERMINAL problems\n");
+	}
+
+	/* WRITEPRINTER wrapping the spooler ring, then FLUSHPRINTER */
+	for (i = 0; i < PRINTLINES; i++) {
+		for (j = 0; j < LINELEN - 1; j++) {
+			text[i * LINELEN + j] = 'a' + (i + j) % 26;
+		}
+		text[i * LINELEN + LINELEN - 1] = '\n';
+	}
+	sstCall(WRITEPRINTER, text, PRINTLINES * LINELEN);
+	sstCall(FLUSHPRINTER, 0, 0);
+	print(WRITETERMINAL, "Printer flushed\n");
+
+	/* dirty every page, then check that each one survived being swapped out */
+	for (i = 0; i < TESTPAGES; i++) {
+		for (j = 0; j < PAGESIZE; j += 512) {
+			pages[i][j] = i + j / 512;
+		}
+	}
+	for (i = 0; i < TESTPAGES; i++) {
+		for (j = 0; j < PAGESIZE; j += 512) {
+			if (pages[i][j] != (char)(i + j / 512)) {
+				print(WRITETERMINAL, "ERROR: swap pool problems\n");
+				i = TESTPAGES;
+				break;
+			}
+		}
+	}
+	print(WRITETERMINAL, "Support Test concluded\n");
+
+	/* Terminate normally */
+	ssi_payload_t terminate_payload = {
+		.service_code = TERMINATE,
+		.arg = 0,
+	};
+	SYSCALL(SENDMSG, PARENT, (unsigned int)&terminate_payload, 0);
+	SYSCALL(RECEIVEMSG, 0, 0, 0);
+}